@@ -0,0 +1,93 @@
+/**
+ * \file
+ * \brief Measures each resampler implementation the host supports.
+ *
+ * Resamples a second of noisy stereo input from the APU's native rate to
+ * 48000 Hz, in blocks of a frame's worth of input. Every implementation is
+ * checked against the scalar filter before it is timed.
+ *
+ * Usage: gb-bench-resampler [seconds]
+ */
+
+#include "sim/apu/APU.h"
+#include "sim/apu/Resampler.h"
+
+#include "loguru.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+//! The output rate measured.
+constexpr unsigned outputRate = 48000;
+
+//! Input samples pushed per block, about one frame's worth.
+constexpr std::size_t blockFrames = APU::sampleRate / 60;
+
+/**
+ * \brief Resample \p in from the start.
+ * \param out The output, sized for it.
+ * \return The number of stereo samples written.
+ */
+std::size_t resample(Resampler &resampler, const std::vector<int16_t> &in, std::vector<int16_t> &out) {
+  resampler.clear();
+  std::size_t frames = in.size() / 2, written = 0;
+  for (std::size_t i = 0; i < frames; i += blockFrames) {
+    std::size_t count = std::min(blockFrames, frames - i);
+    written += resampler.push(in.data() + 2 * i, count, out.data() + 2 * written);
+  }
+  return written;
+}
+
+/**
+ * \brief Time \p seconds seconds of input with \p impl.
+ * \return Nanoseconds per output sample.
+ */
+double run(Resampler::Impl impl, const std::vector<int16_t> &in, uint64_t seconds) {
+  Resampler resampler(APU::sampleRate, outputRate, impl);
+  std::vector<int16_t> out(in.size());
+  std::size_t written = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < seconds; ++i)
+    written += resample(resampler, in, out);
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / written;
+}
+
+} // End anonymous namespace.
+
+int main(int argc, char **argv) {
+  loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+  uint64_t seconds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200ull;
+
+  // Square waves plus noise, as loud as the APU gets.
+  std::vector<int16_t> in(2 * APU::sampleRate);
+  uint32_t seed = 0x2545F491u;
+  for (std::size_t i = 0; i < in.size(); ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    int square = (i / 2) % 149 < 75 ? 24000 : -24000;
+    in[i] = static_cast<int16_t>(square + static_cast<int>(seed >> 21u) - 1024);
+  }
+
+  std::vector<int16_t> expected(in.size()), actual(in.size());
+  Resampler scalar(APU::sampleRate, outputRate, Resampler::Impl::Scalar);
+  std::size_t count = resample(scalar, in, expected);
+
+  std::printf("selected: %s\n%-8s %8s\n", Resampler::name(Resampler::best()), "impl", "ns/out");
+  for (Resampler::Impl impl : {Resampler::Impl::Scalar, Resampler::Impl::SSE2, Resampler::Impl::AVX2}) {
+    if (!Resampler::supported(impl))
+      continue;
+
+    Resampler resampler(APU::sampleRate, outputRate, impl);
+    if (resample(resampler, in, actual) != count || actual != expected)
+      ABORT_F("%s resampler disagrees with the scalar resampler.", Resampler::name(impl));
+
+    std::printf("%-8s %8.2f\n", Resampler::name(impl), run(impl, in, seconds));
+  }
+  return 0;
+}
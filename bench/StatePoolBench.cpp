@@ -0,0 +1,99 @@
+/**
+ * \file
+ * \brief Measures random RAM access across many pooled machine states.
+ *
+ * Each run touches WRAM and VRAM at random offsets of randomly chosen
+ * instances, the pattern many simulators interleaved in one process produce,
+ * with the pool backed by normal pages and then by huge pages.
+ *
+ * Usage: gb-bench-pool [accesses]
+ */
+
+#include "sim/StatePool.h"
+
+#include "loguru.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+//! A small, fast PRNG so the generator doesn't dominate the measurement.
+struct XorShift {
+  uint64_t s;
+  uint64_t operator()() {
+    s ^= s << 13u;
+    s ^= s >> 7u;
+    s ^= s << 17u;
+    return s;
+  }
+};
+
+const char *backingName(StatePool::Backing backing) {
+  switch (backing) {
+  case StatePool::Backing::Normal: return "normal";
+  case StatePool::Backing::Transparent: return "transparent huge";
+  case StatePool::Backing::Explicit: return "explicit huge";
+  }
+  return "?";
+}
+
+/**
+ * \brief Time random accesses across \p instances states.
+ * \return Nanoseconds per access.
+ */
+double run(std::size_t instances, StatePool::Backing preferred, uint64_t accesses,
+           StatePool::Backing &used) {
+  StatePool pool(instances, preferred);
+  used = pool.backing();
+
+  std::vector<MachineState *> states;
+  for (std::size_t i = 0; i < instances; ++i) {
+    states.push_back(pool.acquire());
+    // Fault every page in before timing.
+    std::memset(states.back(), 0, sizeof(MachineState));
+  }
+
+  XorShift rng {0x9E3779B97F4A7C15ull};
+  uint64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < accesses; ++i) {
+    uint64_t r = rng();
+    MachineState *s = states[r % instances];
+    r >>= 16u;
+    // Alternate between VRAM and WRAM as a CPU and PPU would.
+    uint8_t &byte = (r & 1u) ? s->VRAM[(r >> 1u) % s->VRAM.size()]
+                             : s->WRAM0[(r >> 1u) % s->WRAM0.size()];
+    sum += byte++;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  for (MachineState *s : states)
+    pool.release(s);
+
+  // Keep the loop from being optimised away.
+  if (sum == 1)
+    std::puts("");
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / accesses;
+}
+
+} // End anonymous namespace.
+
+int main(int argc, char **argv) {
+  loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+  uint64_t accesses = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000ull;
+
+  std::printf("%10s  %-18s %10s\n", "instances", "backing", "ns/access");
+  for (std::size_t instances : {1u, 64u, 1024u}) {
+    for (StatePool::Backing preferred : {StatePool::Backing::Normal, StatePool::Backing::Explicit}) {
+      StatePool::Backing used;
+      double ns = run(instances, preferred, accesses, used);
+      std::printf("%10zu  %-18s %10.2f\n", instances, backingName(used), ns);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * \file
+ * \brief Measures each tile decoder implementation the host supports.
+ *
+ * Decodes batches of 21 rows, the number a background line needs, from
+ * random plane bytes. Every implementation is checked against the scalar
+ * decoder before it is timed.
+ *
+ * Usage: gb-bench-tiles [batches]
+ */
+
+#include "sim/ppu/TileDecoder.h"
+
+#include "loguru.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+//! Rows decoded per batch, as for one background line.
+constexpr unsigned batchRows = 21;
+
+const char *implName(TileDecoder::Impl impl) {
+  switch (impl) {
+  case TileDecoder::Impl::Scalar: return "scalar";
+  case TileDecoder::Impl::SSE2: return "SSE2";
+  case TileDecoder::Impl::BMI2: return "BMI2";
+  case TileDecoder::Impl::AVX2: return "AVX2";
+  }
+  return "?";
+}
+
+/**
+ * \brief Time \p batches batches with \p impl.
+ * \return Nanoseconds per row.
+ */
+double run(TileDecoder::Impl impl, const std::vector<uint8_t> &planes, uint64_t batches) {
+  std::size_t count = planes.size() / (batchRows * 2);
+  uint8_t out[batchRows * 8];
+  uint64_t sum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < batches; ++i) {
+    TileDecoder::decodeWith(impl, planes.data() + (i % count) * batchRows * 2, batchRows, out);
+    sum += out[i % sizeof out];
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  // Keep the loop from being optimised away.
+  if (sum == 1)
+    std::puts("");
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / (batches * batchRows);
+}
+
+} // End anonymous namespace.
+
+int main(int argc, char **argv) {
+  loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+  uint64_t batches = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000ull;
+
+  std::vector<uint8_t> planes(batchRows * 2 * 256);
+  uint32_t seed = 0x2545F491u;
+  for (uint8_t &b : planes) {
+    seed = seed * 1664525u + 1013904223u;
+    b = static_cast<uint8_t>(seed >> 24u);
+  }
+
+  std::vector<uint8_t> expected(planes.size() * 4), actual(planes.size() * 4);
+  unsigned rows = static_cast<unsigned>(planes.size() / 2);
+  TileDecoder::decodeWith(TileDecoder::Impl::Scalar, planes.data(), rows, expected.data());
+
+  std::printf("selected: %s\n%-8s %8s\n", TileDecoder::name(), "impl", "ns/row");
+  for (TileDecoder::Impl impl : {TileDecoder::Impl::Scalar, TileDecoder::Impl::SSE2,
+                                 TileDecoder::Impl::BMI2, TileDecoder::Impl::AVX2}) {
+    if (!TileDecoder::supported(impl))
+      continue;
+
+    // Odd row counts exercise every tail path.
+    for (unsigned n = 1; n <= 7; ++n) {
+      std::memset(actual.data(), 0xFF, actual.size());
+      TileDecoder::decodeWith(impl, planes.data(), rows - n, actual.data());
+      if (std::memcmp(actual.data(), expected.data(), (rows - n) * 8u) != 0)
+        ABORT_F("%s decoder disagrees with the scalar decoder.", implName(impl));
+    }
+
+    std::printf("%-8s %8.2f\n", implName(impl), run(impl, planes, batches));
+  }
+  return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef GB_MACHINESTATE_H
+#define GB_MACHINESTATE_H
+
+#include "sim/apu/APU.h"
+#include "sim/mem/RealTimeClock.h"
+#include "sim/ppu/PPU.h"
+#include "sim/timer/Timer.h"
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+//! Interrupt request bits, as in IF (0xFF0F) and IE (0xFFFF).
+namespace irq {
+
+//! The offset of IF in the I/O registers.
+constexpr uint8_t IF = 0x0F;
+
+constexpr uint8_t VBlank = 0x01;
+constexpr uint8_t Stat = 0x02;
+constexpr uint8_t Timer = 0x04;
+constexpr uint8_t Serial = 0x08;
+constexpr uint8_t Joypad = 0x10;
+
+} // End namespace irq.
+
+//! Memory bank controller registers.
+struct MapperState {
+  //! The selected ROM bank for 0x4000-0x7FFF.
+  uint16_t romBank;
+
+  //! The selected RAM bank or, on MBC3, RTC register.
+  uint8_t ramBank;
+
+  //! Whether ERAM (and RTC) access is enabled.
+  uint8_t ramEnable;
+
+  //! The last value written to the MBC3 latch register.
+  uint8_t latch;
+};
+
+/**
+ * \brief Everything a single simulated machine owns, in one flat POD.
+ *
+ * The ROM is referenced by the memory controller rather than contained, so
+ * instances running the same cartridge share it. Keeping the rest in one
+ * trivially copyable block lets hosts pack instances densely and snapshot or
+ * restore a machine with a single memcpy.
+ *
+ * Peripherals add their state here as they are implemented.
+ */
+struct MachineState {
+  //! The number of clock cycles elapsed since the machine was created.
+  uint64_t cycles;
+
+  //! The current program counter.
+  uint16_t PC;
+
+  //! The current stack pointer.
+  uint16_t SP;
+
+  //! The registers (AF, BC, DE, HL).
+  uint16_t regs[4];
+
+  //! VRAM bank 0.
+  std::array<uint8_t, 1u << 13u> VRAM;
+
+  //! Work RAM bank 0.
+  std::array<uint8_t, 1u << 12u> WRAM0;
+
+  //! Work RAM bank 1.
+  std::array<uint8_t, 1u << 12u> WRAM1;
+
+  //! Sprite attribute table.
+  std::array<uint8_t, 160> SAT;
+
+  //! I/O registers.
+  std::array<uint8_t, 128> IO;
+
+  //! High RAM.
+  std::array<uint8_t, 127> HRAM;
+
+  //! Interrupts Enable (IE) register.
+  uint8_t IE;
+
+  //! Memory bank controller registers.
+  MapperState mapper;
+
+  //! The MBC3 real time clock.
+  RtcState rtc;
+
+  //! The PPU timing state.
+  PpuState ppu;
+
+  //! The APU channel and sequencer state.
+  ApuState apu;
+
+  //! The divider and timer state.
+  TimerState timer;
+
+  //! External (cartridge) RAM, sized for the largest MBC3 configuration of
+  //! four 8 KiB banks.
+  std::array<uint8_t, 1u << 15u> ERAM;
+};
+
+static_assert(std::is_trivially_copyable<MachineState>::value,
+              "MachineState must be copyable with memcpy.");
+static_assert(std::is_standard_layout<MachineState>::value,
+              "MachineState must have a flat layout.");
+static_assert(sizeof(MachineState) <= 49u * 1024u,
+              "MachineState should stay compact: 16 KiB internal RAM, 32 KiB ERAM.");
+
+#endif // GB_MACHINESTATE_H
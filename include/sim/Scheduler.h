@@ -0,0 +1,91 @@
+#ifndef GB_SCHEDULER_H
+#define GB_SCHEDULER_H
+
+#include <cstdint>
+#include <limits>
+
+/**
+ * \brief When each peripheral next needs the machine's attention.
+ *
+ * Peripherals register the absolute cycle of their next event, such as the
+ * PPU's next mode change, and are only caught up once the machine clock
+ * reaches it. Between events nothing is ticked, so advancing the clock costs
+ * one comparison against next().
+ *
+ * An indexed binary min-heap with one entry per kind of event: registering
+ * an event replaces any earlier deadline for it. Events due at the same
+ * cycle come out in Event order, so runs are deterministic.
+ */
+class Scheduler {
+public:
+  //! The kinds of event, one deadline each.
+  enum Event : uint8_t {
+    Ppu,    //< The PPU's next mode change, or frame while the LCD is off.
+    Apu,    //< The APU's next batch.
+    Timer,  //< The next TIMA overflow.
+    Events  //< The number of kinds of event.
+  };
+
+  //! The deadline of an event that isn't scheduled.
+  constexpr static uint64_t never = std::numeric_limits<uint64_t>::max();
+
+  Scheduler();
+
+  /**
+   * \brief Register an event, replacing its earlier deadline.
+   * \param event The event.
+   * \param cycle The machine cycle count it is due at.
+   */
+  void schedule(Event event, uint64_t cycle);
+
+  //! Drop an event's deadline.
+  void cancel(Event event);
+
+  //! An event's deadline, or never.
+  uint64_t deadline(Event event) const { return slot[event] < count ? deadlines[event] : never; }
+
+  //! The earliest deadline, or never.
+  uint64_t next() const { return count > 0 ? deadlines[heap[0]] : never; }
+
+  /**
+   * \brief Take the earliest event due.
+   *
+   * The event is dropped; its handler registers the next one.
+   *
+   * \param now The machine cycle count.
+   * \param event Set to the event.
+   * \return false if no event is due by \p now.
+   */
+  bool pop(uint64_t now, Event &event);
+
+private:
+  //! Whether heap entry \p a comes out before \p b.
+  bool before(Event a, Event b) const {
+    return deadlines[a] < deadlines[b] || (deadlines[a] == deadlines[b] && a < b);
+  }
+
+  //! Put \p event at heap index \p i.
+  void place(unsigned i, Event event) {
+    heap[i] = event;
+    slot[event] = static_cast<uint8_t>(i);
+  }
+
+  //! Restore the heap order from index \p i up or down.
+  void siftUp(unsigned i);
+  void siftDown(unsigned i);
+
+private:
+  //! Each event's deadline, valid while it is in the heap.
+  uint64_t deadlines[Events];
+
+  //! The scheduled events, earliest first.
+  Event heap[Events];
+
+  //! Each event's index in the heap, or Events if not scheduled.
+  uint8_t slot[Events];
+
+  //! The number of scheduled events.
+  unsigned count;
+};
+
+#endif // GB_SCHEDULER_H
@@ -0,0 +1,199 @@
+#ifndef GB_SHAREDFRAMESINK_H
+#define GB_SHAREDFRAMESINK_H
+
+#include "sim/MachineState.h"
+#include "sim/ppu/PixelFormat.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Shared frame counters must be lock free to work across processes.");
+
+//! The start of a shared frame segment.
+struct SharedFrameHeader {
+  //! "GBFS".
+  char magic[4];
+
+  //! The layout version.
+  uint32_t version;
+
+  //! The frame size and layout.
+  uint32_t width;
+  uint32_t height;
+  uint32_t pitch;
+  PixelFormat format;
+
+  //! Whether slots hold a ::MachineState after the frame.
+  uint8_t hasState;
+
+  //! The size of a ::MachineState, for readers built separately.
+  uint32_t stateSize;
+
+  //! The offset of each slot from the start of the segment.
+  uint64_t slotOffset[2];
+
+  //! The offsets of the pixels and state within a slot.
+  uint64_t pixelsOffset;
+  uint64_t stateOffset;
+
+  //! The number of frames published. The newest is in slot (latest - 1) % 2.
+  alignas(64) std::atomic<uint64_t> latest;
+};
+
+//! The start of a slot in a shared frame segment.
+struct SharedFrameSlot {
+  //! Odd while the slot is being written, bumped to even once complete.
+  alignas(64) std::atomic<uint64_t> sequence;
+
+  //! The frame number, as counted in PpuState::frame.
+  uint64_t frame;
+
+  //! The machine cycle count at the end of the frame.
+  uint64_t cycles;
+
+  //! The frame hash, equal for identical pictures; see PPU::frameHash().
+  uint64_t hash;
+};
+
+/**
+ * \brief Publishes completed frames to a POSIX shared memory segment.
+ *
+ * The segment holds two slots. The PPU composes straight into the slot
+ * being written, so publishing is no more than bumping counters (plus a
+ * copy of the machine state, if asked for). Each slot is guarded by a
+ * sequence counter, odd while the slot is written, and the header says
+ * which slot was published last. A reader can therefore use the newest
+ * frame in place and check afterwards that it wasn't overwritten, which
+ * can only happen if it held on for a whole frame. See SharedFrameReader.
+ */
+class SharedFrameSink {
+public:
+  /**
+   * \brief Create and map a segment, replacing any with the same name.
+   *
+   * \param name The segment name, starting with '/'.
+   * \param format The pixel format to publish.
+   * \param withState Whether to publish the ::MachineState with each frame.
+   * \return The sink, or nullptr if the segment couldn't be created.
+   */
+  static std::unique_ptr<SharedFrameSink> create(const char *name, PixelFormat format,
+                                                 bool withState);
+
+  SharedFrameSink(const SharedFrameSink &) = delete;
+  SharedFrameSink &operator=(const SharedFrameSink &) = delete;
+
+  //! Unmap and unlink the segment.
+  ~SharedFrameSink();
+
+  //! The framebuffer of the slot being written.
+  Framebuffer framebuffer() const;
+
+  /**
+   * \brief Publish the slot being written and start writing the other.
+   *
+   * \param frame The frame number.
+   * \param hash The frame hash.
+   * \param state The machine state to publish with it; ignored unless the
+   * sink was created with state.
+   */
+  void publish(uint64_t frame, uint64_t hash, const MachineState &state);
+
+private:
+  SharedFrameSink(std::string name, void *map, std::size_t size);
+
+  //! A slot by index.
+  SharedFrameSlot &slot(unsigned index) const;
+
+  //! Mark the slot being written as in progress.
+  void beginSlot();
+
+private:
+  //! The segment name.
+  std::string name;
+
+  //! The mapping.
+  void *map;
+
+  //! The mapping size.
+  std::size_t size;
+
+  //! The segment header, at the start of the mapping.
+  SharedFrameHeader *header;
+
+  //! The slot being written.
+  unsigned writing;
+};
+
+/**
+ * \brief Reads frames published by a SharedFrameSink in another process.
+ *
+ * \code
+ * SharedFrameReader::View view;
+ * if (reader->acquire(view)) {
+ *   use(view.pixels);
+ *   if (!reader->valid(view))
+ *     discard();
+ * }
+ * \endcode
+ */
+class SharedFrameReader {
+public:
+  //! The newest frame, in place in the segment.
+  struct View {
+    uint64_t frame;
+    uint64_t cycles;
+
+    //! Equal to the previous view's hash if the picture didn't change.
+    uint64_t hash;
+
+    const uint8_t *pixels;
+
+    //! The machine state, or nullptr if the sink doesn't publish it.
+    const uint8_t *state;
+
+    //! The slot and its sequence when acquired.
+    unsigned slot;
+    uint64_t sequence;
+  };
+
+  /**
+   * \brief Map an existing segment read only.
+   * \return The reader, or nullptr if there is no valid segment.
+   */
+  static std::unique_ptr<SharedFrameReader> open(const char *name);
+
+  SharedFrameReader(const SharedFrameReader &) = delete;
+  SharedFrameReader &operator=(const SharedFrameReader &) = delete;
+
+  ~SharedFrameReader();
+
+  //! The segment header.
+  const SharedFrameHeader &info() const { return *header; }
+
+  /**
+   * \brief Find the newest complete frame.
+   * \return false if nothing has been published yet.
+   */
+  bool acquire(View &view) const;
+
+  //! Whether a view's slot is still unmodified since acquire().
+  bool valid(const View &view) const;
+
+private:
+  SharedFrameReader(const void *map, std::size_t size);
+
+  //! The mapping.
+  const void *map;
+
+  //! The mapping size.
+  std::size_t size;
+
+  //! The segment header, at the start of the mapping.
+  const SharedFrameHeader *header;
+};
+
+#endif // GB_SHAREDFRAMESINK_H
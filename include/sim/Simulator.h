@@ -1,10 +1,21 @@
 #ifndef GB_SIMULATOR_H
 #define GB_SIMULATOR_H
 
+#include "sim/MachineState.h"
+#include "sim/SharedFrameSink.h"
+#include "sim/StatePool.h"
+#include "sim/apu/APU.h"
+#include "sim/apu/AudioRecorder.h"
+#include "sim/apu/AudioRing.h"
 #include "sim/mem/MemoryController.h"
+#include "sim/ppu/PPU.h"
+#include "sim/rom/RomImage.h"
+#include "sim/timer/Timer.h"
 #include "sim/RegisterInfo.h"
+#include "sim/Scheduler.h"
 
 #include <memory>
+#include <string>
 
 namespace regdefaults {
 
@@ -13,6 +24,28 @@ constexpr uint16_t physRegs[4] = {0x01B0, 0x0013, 0x00D8, 0x014D};
 
 }
 
+//! Per instance simulator configuration.
+struct SimulatorOptions {
+  //! Run without any video output: the PPU keeps its registers, timing and
+  //! interrupts up to date but never composes pixels or allocates anything
+  //! to compose them with.
+  bool headless = false;
+
+  //! Run without sound output: the APU keeps the channel bits in NR52, the
+  //! length counters and the sweep overflow up to date but never synthesizes
+  //! samples.
+  bool silent = false;
+
+  //! Compose pixels on a second thread rather than the emulation thread.
+  //! Frames then land in the framebuffer shortly after VBlank; see
+  //! Simulator::waitComposed().
+  bool renderThread = false;
+
+  //! Compose each frame in one pass at VBlank, replaying the frame's LCD
+  //! register writes. Ignored with renderThread.
+  bool deferredRender = false;
+};
+
 class Simulator {
 public:
   //! Simulator must be loaded with a ROM.
@@ -29,12 +62,221 @@ public:
    * filepath.
    *
    * \param romLoc Filepath to ROM.
+   * \param options The simulator configuration.
+   */
+  Simulator(const char *romLoc, const SimulatorOptions &options = SimulatorOptions());
+
+  /**
+   * \brief Initialise the simulator with an already loaded ROM.
+   *
+   * Simulators constructed from the same image share it rather than each
+   * holding a copy.
+   *
+   * \param rom The ROM image.
+   * \param pool The pool to take the machine state from, or nullptr to
+   * allocate it on the heap. The pool must outlive the simulator.
+   * \param options The simulator configuration.
    */
-  Simulator(const char *romLoc);
+  explicit Simulator(std::shared_ptr<const RomImage> rom, StatePool *pool = nullptr,
+                     const SimulatorOptions &options = SimulatorOptions());
+
+  //! Write battery backed cartridge state back to the save file.
+  ~Simulator();
 
   //! Run the simulation.
   void run();
 
+  /**
+   * \brief Advance the machine clock, catching up the peripherals whose
+   * events are due.
+   *
+   * Costs one comparison unless an event is due, so the CPU core may call
+   * this after each instruction, or run straight to nextEvent() and call it
+   * once. Hosts may also call it to drive the peripherals directly.
+   *
+   * \param cycles The number of clock cycles to advance by.
+   */
+  void advance(uint32_t cycles) {
+    state->cycles += cycles;
+    if (state->cycles >= scheduler.next())
+      dispatch();
+  }
+
+  /**
+   * \brief The machine cycle count at which the next peripheral event is
+   * due.
+   *
+   * Nothing outside the CPU changes before then, except through the
+   * registers, so instructions may run until the cycle count reaches it
+   * before calling advance().
+   */
+  uint64_t nextEvent() const { return scheduler.next(); }
+
+  /**
+   * \brief Set the framebuffer the PPU composes into.
+   *
+   * Lines are written straight into \p fb in \p format, with no intermediate
+   * frame. Ignored when headless.
+   *
+   * \param fb lcd::height lines of lcd::width pixels, or nullptr to stop
+   * composing. Owned by the caller; with a render thread it must outlive the
+   * simulator.
+   * \param format The pixel format.
+   * \param pitch The distance between lines in bytes, or 0 if they are packed.
+   */
+  void setFramebuffer(void *fb, PixelFormat format = PixelFormat::Index8, std::size_t pitch = 0) {
+    ppu.setFramebuffer(Framebuffer {static_cast<uint8_t *>(fb), format, pitch});
+  }
+
+  /**
+   * \brief Publish composed frames to POSIX shared memory.
+   *
+   * Frames are composed straight into the segment, replacing any framebuffer
+   * set before, and published at VBlank for other processes to read with a
+   * SharedFrameReader. Each frame is published at its own VBlank, however
+   * far one advance() goes; frames skipped or passed with the LCD off are
+   * not. A segment published before is released once a render thread has
+   * finished with it; if the new one fails, composing stops.
+   *
+   * \param name The segment name, starting with '/'.
+   * \param format The pixel format to publish.
+   * \param withState Whether to publish the machine state with each frame.
+   * \return false if the segment couldn't be created or the simulator is
+   * headless.
+   */
+  bool publishFrames(const char *name, PixelFormat format = PixelFormat::Index8,
+                     bool withState = false);
+
+  /**
+   * \brief Also write downscaled, cropped greyscale observations.
+   *
+   * Each composed frame's observation goes to the next slot of the caller's
+   * ring, whether or not there is a framebuffer. Ignored when headless.
+   *
+   * \param spec Where and how, or a spec with no ring to stop.
+   * \return false if \p spec is invalid.
+   */
+  bool setObservation(const ObservationSpec &spec) { return ppu.setObservation(spec); }
+
+  //! The number of observations written; the newest is in slot
+  //! (observations() - 1) % slots.
+  uint64_t observations() const { return ppu.observations(); }
+
+  /**
+   * \brief Compose only some frames, e.g. when fast forwarding.
+   *
+   * The PPU's timing and interrupts are unaffected. Of every \p period frames
+   * the first \p skip are not composed.
+   *
+   * \param skip The number of frames to skip per period.
+   * \param period The length of the skip pattern, in frames.
+   */
+  void setFrameSkip(unsigned skip, unsigned period) { ppu.setFrameSkip(skip, period); }
+
+  //! Whether the simulator was created headless.
+  bool headless() const { return ppu.headless(); }
+
+  //! Whether the simulator was created without sound output.
+  bool silent() const { return apu.silent(); }
+
+  //! The number of frames completed. Frame n is drawn while this returns n.
+  //! Frames keep passing while the LCD is off, but are not composed.
+  uint64_t frame() const { return state->ppu.frame; }
+
+  /**
+   * \brief Whether a frame is composed under the frame skip setting.
+   * \param frame The frame number, as returned by frame().
+   */
+  bool composes(uint64_t frame) const { return ppu.composes(frame); }
+
+  /**
+   * \brief Wait until a frame is in the framebuffer.
+   *
+   * Only blocks when composing on a render thread; otherwise frames are
+   * complete by the time frame() moves past them.
+   *
+   * \param frame The frame number, as returned by frame().
+   */
+  void waitComposed(uint64_t frame) const { ppu.waitComposed(frame); }
+
+  /**
+   * \brief The hash of the newest composed frame.
+   *
+   * Equal hashes mean identical pictures, so a recorder can skip encoding
+   * repeats. Held while frames are skipped or the LCD is off. Final once
+   * waitComposed() returned for the frame.
+   */
+  uint64_t frameHash() const { return ppu.frameHash(); }
+
+  /**
+   * \brief Resample the sound to a host rate, such as 44100 or 48000 Hz.
+   * \param rate The rate in Hz, or 0 for the native APU::sampleRate.
+   */
+  void setSampleRate(unsigned rate) { apu.setOutputRate(rate); }
+
+  /**
+   * \brief Stream the sound to an audio thread through a lock-free ring.
+   *
+   * The ring is written as the APU catches up, about every 16 ms of machine
+   * time, at the ring's rate. Nothing is left for readSamples().
+   *
+   * \param ring The ring, which must outlive the simulator, or nullptr to
+   * stop streaming.
+   */
+  void streamAudio(AudioRing *ring) { apu.attachStream(ring); }
+
+  /**
+   * \brief Record the sound to WAV files, the mix and each channel.
+   *
+   * Writes <prefix>-mix.wav and <prefix>-ch1.wav to -ch4.wav at
+   * APU::sampleRate from a background thread, finishing them when recording
+   * stops. Recording takes nothing from readSamples() or streamAudio().
+   *
+   * \param prefix The path the file names start with, or nullptr to stop.
+   * \return false if the files couldn't be created or the simulator is
+   * silent.
+   */
+  bool recordAudio(const char *prefix);
+
+  //! The number of stereo samples ready to read.
+  std::size_t samplesAvailable() const { return apu.samplesAvailable(); }
+
+  /**
+   * \brief Read the sound generated so far.
+   *
+   * Samples not read are dropped once about a quarter of a second has
+   * built up.
+   *
+   * \param out The samples, interleaved left then right.
+   * \param frames The maximum number of stereo samples to read.
+   * \return The number of stereo samples read.
+   */
+  std::size_t readSamples(int16_t *out, std::size_t frames) { return apu.readSamples(out, frames); }
+
+  /**
+   * \brief The machine's complete state.
+   *
+   * Everything but the ROM, as one flat block that may be snapshot and
+   * restored with memcpy.
+   */
+  MachineState &machineState() { return *state; }
+
+  //! \copydoc machineState()
+  const MachineState &machineState() const { return *state; }
+
+  /**
+   * \brief Drop everything derived from the machine state.
+   *
+   * Call after modifying the state other than through the simulator, such
+   * as restoring a snapshot with memcpy.
+   */
+  void stateRestored() {
+    ppu.vramReplaced();
+    ppu.schedule();
+    apu.stateRestored();
+    timer.schedule();
+  }
+
 private:
   //! Reset the simulator's internal state (registers, RAM, stack, etc.).
   void reset();
@@ -45,18 +287,52 @@ private:
    */
   void load(const char *romLoc);
 
+  /**
+   * \brief Map the ROM image provided.
+   * \param image The ROM image.
+   */
+  void load(std::shared_ptr<const RomImage> image);
+
+  //! Load battery backed cartridge state from the save file, if present.
+  void loadBattery();
+
+  //! Write battery backed cartridge state to the save file.
+  void saveBattery() const;
+
+  //! Handle every event due.
+  void dispatch();
+
 private:
-  //! The simulator's current program counter.
-  uint16_t PC;
+  //! The machine's state: registers, RAM and cycle counter.
+  std::unique_ptr<MachineState, StatePool::Deleter> state;
 
-  //! The simulator's current stack pointer.
-  uint16_t SP;
+  //! The ROM image, possibly shared with other simulators.
+  std::shared_ptr<const RomImage> rom;
 
-  //! The simulator's registers.
-  uint16_t regs[4];
+  //! The shared memory frame sink, or nullptr. Outlives the PPU, whose
+  //! render thread finishes any queued lines into it as it stops.
+  std::unique_ptr<SharedFrameSink> sink;
+
+  //! When the peripherals next need catching up.
+  Scheduler scheduler;
+
+  //! The picture processing unit.
+  PPU ppu;
+
+  //! The audio processing unit.
+  APU apu;
+
+  //! The divider and timer.
+  Timer timer;
 
   //! The memory controller for the simulator, created based on ROM.
   std::unique_ptr<MemoryController> mem;
+
+  //! The battery save filepath, derived from the ROM filepath.
+  std::string savePath;
+
+  //! The audio recorder, or nullptr.
+  std::unique_ptr<AudioRecorder> recorder;
 };
 
 #endif // GB_SIMULATOR_H
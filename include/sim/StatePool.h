@@ -0,0 +1,98 @@
+#ifndef GB_STATEPOOL_H
+#define GB_STATEPOOL_H
+
+#include "sim/MachineState.h"
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * \brief A fixed capacity pool of ::MachineState slots in one mapping.
+ *
+ * When many simulators run in one process, their RAM is touched in a pattern
+ * that looks random across instances and thrashes the TLB with 4 KiB pages.
+ * The pool backs all slots with a single mapping that uses 2 MiB huge pages
+ * when the host allows, falling back to normal pages otherwise.
+ */
+class StatePool {
+public:
+  //! How the pool's mapping is backed.
+  enum struct Backing : uint8_t {
+    Normal,      //< Normal pages.
+    Transparent, //< Transparent huge pages (madvise(MADV_HUGEPAGE)).
+    Explicit     //< Explicit huge pages from the hugetlbfs pool (MAP_HUGETLB).
+  };
+
+  //! Deletes states from a pool, or from the heap if the pool is null.
+  struct Deleter {
+    //! The owning pool, or nullptr if the state was heap allocated.
+    StatePool *pool = nullptr;
+
+    //! Release or delete \p s.
+    void operator()(MachineState *s) const;
+  };
+
+  //! The huge page size.
+  constexpr static std::size_t hugePageSize = 1u << 21u;
+
+  //! The size of one slot: a state rounded up to a cache line.
+  constexpr static std::size_t slotSize = (sizeof(MachineState) + 63u) & ~std::size_t(63u);
+
+  /**
+   * \brief Map a pool.
+   *
+   * Backing is tried from \p preferred downwards: explicit huge pages, then
+   * transparent huge pages, then normal pages.
+   *
+   * \param capacity The number of states the pool can hold.
+   * \param preferred The preferred backing.
+   */
+  explicit StatePool(std::size_t capacity, Backing preferred = Backing::Explicit);
+
+  //! StatePool owns a mapping and can't be copied.
+  StatePool(const StatePool &) = delete;
+
+  //! Unmap the pool. All states must have been released.
+  ~StatePool();
+
+  /**
+   * \brief Take a value-initialised state from the pool.
+   * \return The state, or nullptr if the pool is exhausted.
+   */
+  MachineState *acquire();
+
+  /**
+   * \brief Return a state to the pool.
+   * \param s A state acquired from this pool.
+   */
+  void release(MachineState *s);
+
+  //! The backing actually in use.
+  Backing backing() const { return mapBacking; }
+
+  //! The number of states the pool can hold.
+  std::size_t capacity() const { return slots; }
+
+private:
+  //! The mapping.
+  uint8_t *base;
+
+  //! The size of ::base.
+  std::size_t mapSize;
+
+  //! The number of slots.
+  std::size_t slots;
+
+  //! The backing actually in use.
+  Backing mapBacking;
+
+  //! Free slot indices, used as a stack so recently freed (warm) slots are
+  //! reused first.
+  std::vector<std::size_t> freeSlots;
+
+  //! Guards ::freeSlots.
+  std::mutex lock;
+};
+
+#endif // GB_STATEPOOL_H
@@ -0,0 +1,304 @@
+#ifndef GB_APU_H
+#define GB_APU_H
+
+#include "sim/Scheduler.h"
+#include "sim/apu/BlipBuffer.h"
+#include "sim/apu/Resampler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class AudioRecorder;
+class AudioRing;
+struct MachineState;
+
+//! Sound register addresses.
+namespace snd {
+
+//! Sound register offsets into the I/O registers.
+enum Reg : uint8_t {
+  NR10 = 0x10, NR11 = 0x11, NR12 = 0x12, NR13 = 0x13, NR14 = 0x14,
+  NR21 = 0x16, NR22 = 0x17, NR23 = 0x18, NR24 = 0x19,
+  NR30 = 0x1A, NR31 = 0x1B, NR32 = 0x1C, NR33 = 0x1D, NR34 = 0x1E,
+  NR41 = 0x20, NR42 = 0x21, NR43 = 0x22, NR44 = 0x23,
+  NR50 = 0x24, NR51 = 0x25, NR52 = 0x26,
+  WaveRam = 0x30, End = 0x40
+};
+
+//! The number of sound channels.
+constexpr unsigned channels = 4;
+
+//! The offset of each channel's first register (NRx0, which channels 2 and
+//! 4 lack). NRx1 to NRx4 follow it.
+constexpr uint8_t channelBase[channels] = {0x10, 0x15, 0x1A, 0x1F};
+
+//! NR52 power bit.
+constexpr uint8_t Power = 0x80;
+
+} // End namespace snd.
+
+//! A sound channel's state.
+struct ApuChannel {
+  //! Clocks until the waveform next steps.
+  uint32_t timer;
+
+  //! The length counter; the channel stops when it runs out.
+  uint16_t length;
+
+  //! Whether the channel is playing, as reported in NR52.
+  uint8_t on;
+
+  //! The waveform position: the duty step (0-7) or wave sample (0-31).
+  uint8_t position;
+
+  //! The envelope volume (0-15).
+  uint8_t volume;
+
+  //! Frame sequencer envelope ticks until the volume next changes.
+  uint8_t envelopeTimer;
+};
+
+/**
+ * \brief The APU state.
+ *
+ * A POD so it can live in ::MachineState. The registers themselves live in
+ * the I/O registers.
+ */
+struct ApuState {
+  //! The machine cycle count the APU has caught up to.
+  uint64_t time;
+
+  //! Clocks until the next frame sequencer step.
+  uint32_t sequencerTimer;
+
+  //! The next frame sequencer step (0-7).
+  uint8_t sequencerStep;
+
+  //! Channel 1 sweep: whether it runs, and ticks until it next steps.
+  uint8_t sweepOn;
+  uint8_t sweepTimer;
+
+  //! Channel 1 sweep shadow frequency.
+  uint16_t sweepFrequency;
+
+  //! The noise channel's linear feedback shift register.
+  uint16_t lfsr;
+
+  //! The four channels.
+  ApuChannel channels[snd::channels];
+};
+
+/**
+ * \brief The audio processing unit.
+ *
+ * Nothing happens per clock. The APU runs in batches, catching up to the
+ * machine clock when a sound register is accessed or enough time has
+ * passed. Within a batch each channel jumps from one waveform step to the
+ * next, and only steps that change its level produce anything: a delta in
+ * the stereo BlipBuffer.
+ *
+ * A silent APU skips even that: channels keep only what games can read
+ * back, their NR52 bits as lengths run out or the sweep overflows, and the
+ * waveforms, envelopes and mixing are never run.
+ */
+class APU {
+public:
+  //! The machine clocks per frame sequencer step (512 Hz).
+  constexpr static unsigned sequencerPeriod = 8192;
+
+  //! The most clocks the APU lets pass before catching up.
+  constexpr static unsigned batchClocks = 1u << 16u;
+
+  //! The native sample rate, before any resampling.
+  constexpr static unsigned sampleRate = BlipBuffer::sampleRate;
+
+  //! APU must be attached to a machine.
+  APU() = delete;
+
+  /**
+   * \param state The machine state, which must outlive the APU.
+   * \param scheduler The scheduler to register batches with, which must
+   * outlive the APU.
+   * \param silent Whether to skip synthesis, keeping only the register state.
+   */
+  APU(MachineState &state, Scheduler &scheduler, bool silent);
+
+  //! Whether the APU was created silent.
+  bool silent() const { return !synthesize; }
+
+  //! Power the APU on with all channels off, ready for the register defaults.
+  void reset();
+
+  /**
+   * \brief Handle the Scheduler::Apu event.
+   *
+   * Only catches up once a batch worth of clocks has passed, then writes
+   * the batch to the stream if there is one. A silent APU never registers
+   * the event, and only catches up when its registers are accessed.
+   */
+  void advance();
+
+  //! Catch up to the machine clock, registering the next batch.
+  void sync();
+
+  /**
+   * \brief Read a sound register or wave RAM.
+   * \param reg The register offset from 0xFF00, 0x10-0x3F.
+   */
+  uint8_t read(uint8_t reg);
+
+  /**
+   * \brief Write a sound register or wave RAM.
+   * \param reg The register offset from 0xFF00, 0x10-0x3F.
+   * \param value The value written.
+   */
+  void write(uint8_t reg, uint8_t value);
+
+  //! Drop everything derived from the machine state, e.g. after restoring
+  //! a snapshot, and register the next batch.
+  void stateRestored();
+
+  /**
+   * \brief Resample the output to a host rate, such as 44100 or 48000 Hz.
+   * \param rate The output rate in Hz, or 0 (or sampleRate) for the native
+   * rate. While streaming the output follows the stream's rate, and this
+   * one takes effect when it stops; see attachStream().
+   */
+  void setOutputRate(unsigned rate);
+
+  /**
+   * \brief Stream the output to an audio thread, resampled to its rate.
+   *
+   * Each batch is written to \p ring as the APU catches up, with the
+   * resampling ratio nudged by AudioRing::rateAdjust(). readSamples() then
+   * finds nothing left to read.
+   *
+   * Stopping restores the rate last set with setOutputRate(), or the native
+   * rate if none was, dropping the stream's rate and nudge.
+   *
+   * \param ring The ring, which must outlive the APU, or nullptr to stop.
+   */
+  void attachStream(AudioRing *ring);
+
+  /**
+   * \brief Record the mix and each channel at sampleRate.
+   *
+   * Samples are handed to \p recorder as the APU catches up, without taking
+   * any from readSamples() or the stream.
+   *
+   * \param recorder The recorder, which must outlive the APU or be detached
+   * first, or nullptr to stop.
+   */
+  void attachRecorder(AudioRecorder *recorder);
+
+  //! The rate samples are read at, in Hz.
+  unsigned outputRate() const { return resampler != nullptr ? resampler->outputRate() : sampleRate; }
+
+  //! The number of stereo samples ready to read, as of the last catch up.
+  //! Always 0 when silent.
+  std::size_t samplesAvailable() const;
+
+  /**
+   * \brief Catch up and read stereo samples at outputRate().
+   * \param out The samples, interleaved left then right.
+   * \param frames The maximum number of stereo samples to read.
+   * \return The number of stereo samples read.
+   */
+  std::size_t readSamples(int16_t *out, std::size_t frames);
+
+private:
+  //! Resample to hostRate, or drop the resampler if it is the native rate.
+  void useHostRate();
+
+  //! Resample the ready samples into \p out, at most \p frames of them.
+  std::size_t drain(int16_t *out, std::size_t frames);
+
+  //! Write the ready samples to the stream.
+  void flush();
+
+  //! Hand the samples the last catch up completed to the recorder.
+  void record();
+
+  //! Run the channels and frame sequencer for a batch of clocks.
+  void run(uint32_t clocks);
+
+  //! Run a channel's waveform from clock \p from to \p to of the batch.
+  void runChannel(unsigned ch, uint32_t from, uint32_t to);
+
+  //! Step a channel's waveform once.
+  void step(unsigned ch);
+
+  //! Clock the length counters, sweep and envelopes for a sequencer step.
+  void stepSequencer(uint32_t time);
+
+  //! Step the channel 1 frequency sweep.
+  void stepSweep(uint32_t time);
+
+  //! Start a channel playing.
+  void trigger(unsigned ch);
+
+  //! Stop a channel at clock \p time of the batch.
+  void stop(unsigned ch, uint32_t time);
+
+  //! Clear the sound registers and stop every channel.
+  void powerOff();
+
+  //! The channel 1 sweep's next frequency, stopping the channel on overflow.
+  unsigned sweepNext(uint32_t time);
+
+  //! A channel's frequency (0-2047), from NRx3 and NRx4.
+  unsigned frequency(unsigned ch) const;
+
+  //! Clocks per waveform step, or 0 if the channel never steps.
+  uint32_t period(unsigned ch) const;
+
+  //! Whether a channel's DAC is on.
+  bool dacOn(unsigned ch) const;
+
+  //! A channel's digital output (0-15).
+  int level(unsigned ch) const;
+
+  //! Update the output with a channel's level at clock \p time of the batch.
+  void output(unsigned ch, uint32_t time);
+
+private:
+  //! The machine state.
+  MachineState &state;
+
+  //! The scheduler batches are registered with.
+  Scheduler &scheduler;
+
+  //! Whether to run the waveforms and produce samples.
+  bool synthesize;
+
+  //! The left and right outputs.
+  BlipBuffer left;
+  BlipBuffer right;
+
+  //! Each channel's amplitude in the left and right outputs.
+  int32_t leftAmp[snd::channels];
+  int32_t rightAmp[snd::channels];
+
+  //! Converts to the output rate, or nullptr to read at sampleRate.
+  std::unique_ptr<Resampler> resampler;
+
+  //! The rate setOutputRate() asked for, or 0 for the native rate.
+  unsigned hostRate;
+
+  //! Native rate samples on their way to the resampler.
+  std::vector<int16_t> native;
+
+  //! The ring the output streams to, or nullptr.
+  AudioRing *stream;
+
+  //! The recorder, or nullptr.
+  AudioRecorder *recorder;
+
+  //! Each channel's own output, and its amplitude in it, while recording.
+  std::vector<BlipBuffer> stems;
+  int32_t stemAmp[snd::channels];
+};
+
+#endif // GB_APU_H
@@ -0,0 +1,112 @@
+#ifndef GB_AUDIORECORDER_H
+#define GB_AUDIORECORDER_H
+
+#include "sim/util/SpscRing.h"
+
+#include <semaphore.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Streams the mixed output and each channel to WAV files.
+ *
+ * Writes <prefix>-mix.wav (stereo) and <prefix>-ch1.wav to -ch4.wav (mono),
+ * 16 bit PCM. Samples are appended to large aligned buffers on the
+ * emulation thread; full buffers go to a writer thread through a lock-free
+ * ring, with a semaphore post to wake it, so the emulation thread never
+ * touches the disk or waits on a lock. The WAV sizes are filled in when the
+ * recorder is destroyed.
+ */
+class AudioRecorder {
+public:
+  //! The number of files: the mix, then one per channel.
+  constexpr static unsigned files = 5;
+
+  //! The size of each buffer handed to the writer.
+  constexpr static std::size_t bufferSize = 1u << 20u;
+
+  /**
+   * \brief Create the files and start the writer thread.
+   * \param prefix The path the file names start with.
+   * \param rate The sample rate, in Hz.
+   * \return The recorder, or nullptr if a file failed to open.
+   */
+  static std::unique_ptr<AudioRecorder> create(const std::string &prefix, unsigned rate);
+
+  //! Write what is left, stop the writer and finish the files.
+  ~AudioRecorder();
+
+  AudioRecorder(const AudioRecorder &) = delete;
+  AudioRecorder &operator=(const AudioRecorder &) = delete;
+
+  /**
+   * \brief Append samples to every file.
+   * \param mix \p frames stereo samples, interleaved left then right.
+   * \param channels \p frames mono samples for each channel.
+   * \param frames The number of samples.
+   */
+  void write(const int16_t *mix, const int16_t *const *channels, std::size_t frames);
+
+private:
+  //! A buffer of one file's bytes.
+  struct Buffer {
+    uint8_t *data;
+    std::size_t used;
+    unsigned file;
+  };
+
+  //! Buffers in flight at most, before the emulation thread waits.
+  constexpr static std::size_t maxBuffers = 64;
+
+  AudioRecorder(std::vector<int> fds, std::vector<std::string> paths);
+
+  //! Append bytes to a file's current buffer.
+  void append(unsigned file, const void *bytes, std::size_t size);
+
+  //! Hand a file's current buffer to the writer and take a fresh one.
+  void submit(unsigned file);
+
+  //! Hand a file's current buffer to the writer, if it holds anything,
+  //! without taking a fresh one; the file must not be appended to after.
+  void send(unsigned file);
+
+  //! A free buffer, allocating one while under maxBuffers.
+  Buffer *acquire(unsigned file);
+
+  //! The writer thread.
+  void work();
+
+  //! Write a buffer to its file.
+  void store(Buffer *buffer);
+
+private:
+  //! The open files and their paths.
+  std::vector<int> fds;
+  std::vector<std::string> paths;
+
+  //! Every buffer, owned by the emulation thread.
+  std::vector<std::unique_ptr<Buffer>> buffers;
+
+  //! The buffer each file is filling.
+  Buffer *current[files];
+
+  //! Full buffers on their way to the writer, and written ones coming back.
+  std::unique_ptr<SpscRing<Buffer *, maxBuffers>> full;
+  std::unique_ptr<SpscRing<Buffer *, maxBuffers>> empty;
+
+  //! Bytes of samples written to each file. Writer only until it stops.
+  uint64_t written[files];
+
+  //! Posted once per buffer in full, then once more to stop the writer.
+  sem_t ready;
+
+  //! The writer thread.
+  std::thread thread;
+};
+
+#endif // GB_AUDIORECORDER_H
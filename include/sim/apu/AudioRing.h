@@ -0,0 +1,89 @@
+#ifndef GB_AUDIORING_H
+#define GB_AUDIORING_H
+
+#include "sim/util/SpscRing.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * \brief Carries stereo samples from the emulation thread to an audio thread.
+ *
+ * The APU writes resampled output as it catches up (see
+ * Simulator::streamAudio()) and the host's audio callback reads it, neither
+ * side ever waiting on the other. The two clocks never quite agree, so the
+ * APU asks rateAdjust() how to nudge its resampling ratio: a little faster
+ * when the ring runs low, a little slower when it fills up, keeping it about
+ * half full with no underruns or pitch drift anyone can hear.
+ */
+class AudioRing {
+public:
+  //! The number of stereo samples the ring holds.
+  constexpr static std::size_t capacity = 4096;
+
+  //! The most the output rate is nudged by, as a fraction.
+  constexpr static double maxAdjust = 0.005;
+
+  //! \param rate The sample rate the consumer plays at, in Hz.
+  explicit AudioRing(unsigned rate);
+
+  //! The sample rate the consumer plays at, in Hz.
+  unsigned rate() const { return sampleRate; }
+
+  /**
+   * \brief Write stereo samples. Producer only.
+   *
+   * Samples that do not fit are dropped and counted in overruns().
+   *
+   * \param samples The samples, interleaved left then right.
+   * \param frames The number of stereo samples.
+   * \return The number of stereo samples written.
+   */
+  std::size_t write(const int16_t *samples, std::size_t frames);
+
+  /**
+   * \brief The dynamic rate control hook. Producer only.
+   *
+   * \return The factor to scale the output rate by: 1 when the ring is half
+   * full, down to 1 - maxAdjust at three quarters full and up to
+   * 1 + maxAdjust at a quarter full.
+   */
+  double rateAdjust() const;
+
+  /**
+   * \brief Read stereo samples. Consumer only.
+   *
+   * Always fills \p out: what the ring lacks is filled with silence and
+   * counted in underruns().
+   *
+   * \param out The samples, interleaved left then right.
+   * \param frames The number of stereo samples wanted.
+   * \return The number of stereo samples read from the ring.
+   */
+  std::size_t read(int16_t *out, std::size_t frames);
+
+  //! The number of stereo samples held. A hint for either side.
+  std::size_t fill() const { return ring->size() / 2; }
+
+  //! The number of stereo samples dropped because the ring was full.
+  uint64_t overruns() const { return dropped.load(std::memory_order_relaxed); }
+
+  //! The number of stereo samples of silence read because it was empty.
+  uint64_t underruns() const { return starved.load(std::memory_order_relaxed); }
+
+private:
+  //! The consumer's sample rate.
+  unsigned sampleRate;
+
+  //! Interleaved samples. Every push and pop is a whole number of stereo
+  //! samples, so left and right never come apart.
+  std::unique_ptr<SpscRing<int16_t, 2 * capacity>> ring;
+
+  //! The overrun and underrun counts.
+  std::atomic<uint64_t> dropped;
+  std::atomic<uint64_t> starved;
+};
+
+#endif // GB_AUDIORING_H
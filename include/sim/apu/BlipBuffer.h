@@ -0,0 +1,134 @@
+#ifndef GB_BLIPBUFFER_H
+#define GB_BLIPBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Turns amplitude steps into band-limited samples.
+ *
+ * Sound channels are square-ish waves that only change level at discrete
+ * clocks. Rather than being sampled every clock, each level change is added
+ * as a delta: a band-limited impulse, picked by where the change falls
+ * between two samples, goes into an accumulation buffer. Reading integrates
+ * the buffer back into levels. The cost is per level change, not per clock,
+ * and there is no aliasing.
+ *
+ * Time is counted in machine clocks from the end of the last frame; see
+ * endFrame().
+ */
+class BlipBuffer {
+public:
+  //! Machine clocks per output sample.
+  constexpr static unsigned clocksPerSample = 64;
+
+  //! The output sample rate, for the 4194304 Hz machine clock.
+  constexpr static unsigned sampleRate = 4194304 / clocksPerSample;
+
+  //! The number of sub-sample positions a delta can fall on.
+  constexpr static unsigned phases = 32;
+
+  //! The number of samples a delta touches.
+  constexpr static unsigned kernelWidth = 16;
+
+  /**
+   * \brief Allocate a buffer.
+   * \param capacity The number of samples it holds, including those not yet
+   * read.
+   */
+  explicit BlipBuffer(std::size_t capacity);
+
+  /**
+   * \brief Add an amplitude step.
+   * \param time The clock of the step, counted from the end of the last frame.
+   * \param delta The change in amplitude.
+   */
+  void addDelta(uint32_t time, int32_t delta);
+
+  /**
+   * \brief Whether a frame of \p clocks fits without reading samples first.
+   * \param clocks The frame length in clocks.
+   */
+  bool fits(uint32_t clocks) const {
+    return ready + (fraction + clocks) / clocksPerSample + kernelWidth <= accum.size();
+  }
+
+  /**
+   * \brief End a frame, making the samples it completed readable.
+   * \param clocks The frame length in clocks. Later deltas count from here.
+   */
+  void endFrame(uint32_t clocks);
+
+  //! The number of samples ready to read.
+  std::size_t available() const { return ready; }
+
+  /**
+   * \brief Read samples.
+   *
+   * \param out The samples to write.
+   * \param count The maximum number of samples to read.
+   * \param stride The distance between samples in \p out, e.g. 2 to write
+   * one side of interleaved stereo.
+   * \return The number of samples read.
+   */
+  std::size_t read(int16_t *out, std::size_t count, std::size_t stride = 1);
+
+  /**
+   * \brief Drop samples as if they were read.
+   * \param count The maximum number of samples to drop.
+   */
+  void discard(std::size_t count);
+
+  //! Drop all samples and deltas.
+  void clear();
+
+  //! The number of ready samples tap() has not seen.
+  std::size_t untapped() const { return ready - tapped; }
+
+  /**
+   * \brief Copy the ready samples tap() has not seen, leaving them to read().
+   *
+   * A second reader that sees every sample exactly as read() will, e.g. to
+   * record them, provided it taps before they are read or discarded.
+   *
+   * \param out Room for untapped() samples.
+   * \param stride The distance between samples in \p out.
+   * \return The number of samples copied.
+   */
+  std::size_t tap(int16_t *out, std::size_t stride = 1);
+
+  //! Mark every ready sample as seen by tap(), so tapping starts from now.
+  void skipTap();
+
+  //! Drop all samples and deltas, and fall in step with \p other: the same
+  //! frames then complete the same number of samples in both.
+  void clearInStep(const BlipBuffer &other);
+
+private:
+  //! Move the unread part of the buffer down by \p count samples.
+  void remove(std::size_t count);
+
+  //! Integrate one sample into \p sum, returning the clamped sample.
+  static int16_t integrate(int32_t &sum, int32_t impulses);
+
+private:
+  //! Impulse sums, 15 fraction bits, for the ready samples and those past
+  //! them that deltas already reach.
+  std::vector<int32_t> accum;
+
+  //! The number of samples ready to read.
+  std::size_t ready;
+
+  //! Clocks from the last ready sample to the end of the last frame.
+  uint32_t fraction;
+
+  //! The running sum reading integrates accum with, 15 fraction bits.
+  int32_t level;
+
+  //! The number of ready samples tap() has seen, and its running sum.
+  std::size_t tapped;
+  int32_t tapLevel;
+};
+
+#endif // GB_BLIPBUFFER_H
@@ -0,0 +1,142 @@
+#ifndef GB_RESAMPLER_H
+#define GB_RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Converts stereo samples from one rate to another.
+ *
+ * A polyphase windowed sinc filter: each output sample is the dot product
+ * of the last taps input samples with the filter phase nearest to where it
+ * falls between them. The filter is in 16 bit fixed point, so each dot
+ * product is a few SIMD multiply-adds. The implementation is picked once,
+ * at startup, from the host's CPU features.
+ *
+ * Input is pushed in blocks and output goes straight into the caller's
+ * buffer. Only the taps samples of history are kept between blocks.
+ */
+class Resampler {
+public:
+  //! Input samples each output sample is filtered from.
+  constexpr static unsigned taps = 32;
+
+  //! The number of fractional positions with their own filter phase.
+  constexpr static unsigned phases = 512;
+
+  //! Filter implementations.
+  enum struct Impl {
+    Scalar, //< One tap at a time.
+    SSE2,   //< 8 taps per multiply-add.
+    AVX2    //< 16 taps per multiply-add.
+  };
+
+  /**
+   * \brief Create a resampler using the fastest implementation.
+   * \param inputRate The input sample rate, in Hz.
+   * \param outputRate The output sample rate, in Hz.
+   */
+  Resampler(unsigned inputRate, unsigned outputRate);
+
+  /**
+   * \brief Create a resampler using a specific implementation.
+   *
+   * For benchmarking and cross-checking, \p impl must be supported by the
+   * host.
+   */
+  Resampler(unsigned inputRate, unsigned outputRate, Impl impl);
+
+  //! The implementation selected at startup.
+  static Impl best();
+
+  //! The name of an implementation, for logging.
+  static const char *name(Impl impl);
+
+  //! Whether the host supports an implementation.
+  static bool supported(Impl impl);
+
+  //! The input sample rate, in Hz.
+  unsigned inputRate() const { return inRate; }
+
+  //! The output sample rate, in Hz.
+  unsigned outputRate() const { return outRate; }
+
+  /**
+   * \brief Nudge the output rate, for dynamic rate control.
+   * \param adjust The factor to scale the output rate by, close to 1.
+   */
+  void setRateAdjust(double adjust);
+
+  /**
+   * \brief Resample a block.
+   *
+   * Consumes all of \p in.
+   *
+   * \param in Stereo input, interleaved left then right.
+   * \param frames The number of stereo input samples.
+   * \param out Room for outputFor(frames) stereo samples.
+   * \return The number of stereo samples written to \p out.
+   */
+  std::size_t push(const int16_t *in, std::size_t frames, int16_t *out);
+
+  //! The number of stereo samples push() writes for \p frames more input.
+  std::size_t outputFor(std::size_t frames) const;
+
+  //! The most input push() can take without writing over \p frames samples.
+  std::size_t inputFor(std::size_t frames) const;
+
+  //! Drop the history, as if starting over.
+  void clear();
+
+private:
+  /**
+   * \brief A filter entry point.
+   *
+   * Produces a stereo output for each position from \p position, \p step
+   * apart, up to \p last.
+   *
+   * \param left The left input history.
+   * \param right The right input history.
+   * \param kernel The filter phases.
+   * \param position The first position, advanced past the last output.
+   * \param last The last position with all its taps in the history.
+   * \param step The distance between positions.
+   * \param out The interleaved outputs.
+   * \return The number of stereo outputs.
+   */
+  using FilterFn = std::size_t (*)(const int16_t *left, const int16_t *right,
+                                   const int16_t *kernel, uint64_t &position, uint64_t last,
+                                   uint64_t step, int16_t *out);
+
+private:
+  //! Input samples per block of history.
+  constexpr static unsigned blockFrames = 1024;
+
+  //! The implementation's entry point.
+  FilterFn filter;
+
+  //! The sample rates.
+  unsigned inRate;
+  unsigned outRate;
+
+  //! The input step per output sample at outputRate, and as adjusted,
+  //! with 32 fraction bits.
+  uint64_t baseStep;
+  uint64_t step;
+
+  //! The filter phases, each taps long and summing to 1 << 15.
+  std::vector<int16_t> kernel;
+
+  //! Input history, one channel after the other, blockFrames + taps each.
+  std::vector<int16_t> history;
+
+  //! The number of samples per channel in history.
+  std::size_t held;
+
+  //! The position of the next output's first tap in history, with 32
+  //! fraction bits.
+  uint64_t position;
+};
+
+#endif // GB_RESAMPLER_H
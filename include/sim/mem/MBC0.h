@@ -7,8 +7,11 @@ class MBC0 : public MemoryController {
 public:
   /**
    * \brief Construct with ROM to map to memory.
+   *
+   * \param rom The ROM image to map.
+   * \param state The machine state holding RAM.
    */
-    MBC0(std::ifstream &rom);
+  MBC0(const RomImage &rom, MachineState &state);
 
   /**
    * \brief Read 8 bits from the specified address.
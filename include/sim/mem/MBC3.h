@@ -0,0 +1,83 @@
+#ifndef GB_MBC3_H
+#define GB_MBC3_H
+
+#include "sim/mem/MemoryController.h"
+#include "sim/mem/RealTimeClock.h"
+
+class MBC3 : public MemoryController {
+public:
+  /**
+   * \brief Construct with ROM to map to memory.
+   *
+   * \param rom The ROM image to map. The cartridge type and RAM size are read
+   * from its header.
+   * \param state The machine state holding RAM, the banking registers and the
+   * RTC. Its cycle counter drives the RTC.
+   */
+  MBC3(const RomImage &rom, MachineState &state);
+
+  /**
+   * \brief Read 8 bits from the specified address.
+   *
+   * \param address The address to read from.
+   * \return The byte at the address.
+   */
+  uint8_t read8(uint16_t address) const override;
+
+  /**
+   * \brief Read 16 bits from the specified address.
+   *
+   * \param address The address to read from.
+   * \return The byte at the address.
+   */
+  uint16_t read16(uint16_t address) const override;
+
+  /**
+   * \brief Write 8 bits to the specified address.
+   *
+   * Writes to the ROM area set the MBC3 control registers.
+   *
+   * \param address The address to write to.
+   * \param data The byte to write.
+   */
+  void write(uint16_t address, uint8_t data) override;
+
+  /**
+   * \brief Write a 16-bit word (little endian) to the specified address.
+   *
+   * \param address The address to write to.
+   * \param data The 16-bit word to write.
+   */
+  void write(uint16_t address, uint16_t data) override;
+
+  /**
+   * \brief Reset memory and banking registers to initial values.
+   *
+   * The RTC is not reset, it keeps running across resets.
+   */
+  void reset() override;
+
+  //! Whether this cartridge has a battery.
+  bool hasBattery() const override { return battery; }
+
+  //! Write ERAM followed by the RTC footer if the cartridge has a timer.
+  void saveBattery(std::ostream &out) const override;
+
+  //! Load ERAM followed by the RTC footer if the cartridge has a timer.
+  void loadBattery(std::istream &in) override;
+
+private:
+  //! The real time clock, present on timer cartridges.
+  RealTimeClock rtc;
+
+  //! The number of 8 KiB ERAM banks.
+  uint8_t ramBanks;
+
+  //! Whether the cartridge has a timer.
+  bool timer;
+
+  //! Whether the cartridge has a battery.
+  bool battery;
+};
+
+#endif // GB_MBC3_H
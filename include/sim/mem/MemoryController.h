@@ -5,7 +5,12 @@
 #include "loguru.hpp"
 #endif
 
+#include "sim/MachineState.h"
+#include "sim/rom/RomImage.h"
+
+#include <array>
 #include <cstdint>
+#include <iosfwd>
 #include <memory>
 
 //! Namespace holding memory defaults.
@@ -102,7 +107,8 @@ inline void leWrite16(std::array<uint8_t, size> &mem, uint16_t address, uint16_t
  * \brief Base class for all memory controllers.
  *
  * The base class for all memory controllers, defining all of the read and write
- * methods.
+ * methods. Controllers don't own memory: RAM lives in the machine's
+ * ::MachineState and ROM in a shared ::RomImage.
  */
 class MemoryController {
 protected:
@@ -134,11 +140,13 @@ protected:
   typedef std::array<uint8_t, 127> arrayHR;
 
 public:
-  //! Initialise all memory fields to nullptr.
-  MemoryController()
-      : ROM0(nullptr), ROM1(nullptr), VRAM(nullptr), ERAM(nullptr),
-        WRAM0(nullptr), WRAM1(nullptr), SAT(nullptr), HRAM(nullptr),
-        IO(nullptr), IER(nullptr) {}
+  /**
+   * \brief Map a ROM and a machine's RAM.
+   * \param rom The ROM image, which must outlive the controller.
+   * \param state The machine state holding RAM, which must outlive the controller.
+   */
+  MemoryController(const RomImage &rom, MachineState &state)
+      : rom(rom), state(state), ppu(nullptr), apu(nullptr), timer(nullptr) {}
 
   virtual ~MemoryController() = default;
 
@@ -195,36 +203,92 @@ public:
    */
   virtual void reset() = 0;
 
-protected:
-  //! ROM bank 00, fixed.
-  std::unique_ptr<std::array<uint8_t, kilo16>> ROM0;
+  /**
+   * \brief Whether the cartridge has battery backed state to persist.
+   *
+   * Subclasses with battery backed RAM or a clock should override this along
+   * with saveBattery() and loadBattery().
+   */
+  virtual bool hasBattery() const { return false; }
+
+  /**
+   * \brief Write the battery backed state (ERAM, then any RTC footer).
+   * \param out The stream to write the save to.
+   */
+  virtual void saveBattery(std::ostream &/*out*/) const { }
 
-  //! ROM Bank 01-NN, switchable based on MBC mode.
-  std::unique_ptr<std::array<uint8_t, kilo16>> ROM1;
+  /**
+   * \brief Load the battery backed state written by saveBattery().
+   * \param in The stream to read the save from.
+   */
+  virtual void loadBattery(std::istream &/*in*/) { }
 
-  //! VRAM Bank 0-1. Switchable in CGB mode, locked to 0 in non-CGB mode.
-  std::unique_ptr<array8k> VRAM;
+  /**
+   * \brief Attach the PPU to notify of VRAM and OAM writes.
+   * \param p The PPU, which must outlive the controller, or nullptr.
+   */
+  void attachPpu(PPU *p) { ppu = p; }
 
-  //! External Ram.
-  std::unique_ptr<array8k> ERAM;
+  /**
+   * \brief Attach the APU to handle the sound registers.
+   * \param a The APU, which must outlive the controller, or nullptr.
+   */
+  void attachApu(APU *a) { apu = a; }
 
-  //! Work ram bank 0.
-  std::unique_ptr<array4k> WRAM0;
+  /**
+   * \brief Attach the timer to handle the divider and timer registers.
+   * \param t The timer, which must outlive the controller, or nullptr.
+   */
+  void attachTimer(Timer *t) { timer = t; }
 
-  //! Work ram bank 1-N. Up to 7 in CGB, locked to 1 in non-CGB mode.
-  std::unique_ptr<array4k> WRAM1;
+protected:
+  /**
+   * \brief Read from the memory internal to the machine.
+   *
+   * Handles everything but the cartridge ROM (0x0000-0x7FFF) and ERAM
+   * (0xA000-0xBFFF) regions, which are up to the subclass.
+   *
+   * \param address The address to read from.
+   * \return The byte at the address.
+   */
+  uint8_t readInternal(uint16_t address) const;
+
+  /**
+   * \brief Write to the memory internal to the machine.
+   *
+   * Handles everything but the cartridge ROM (0x0000-0x7FFF) and ERAM
+   * (0xA000-0xBFFF) regions, which are up to the subclass.
+   *
+   * \param address The address to write to.
+   * \param data The byte to write.
+   */
+  void writeInternal(uint16_t address, uint8_t data);
+
+  /**
+   * \brief Write an I/O register, applying its side effects.
+   * \param reg The register offset from 0xFF00.
+   * \param data The byte to write.
+   */
+  void writeIO(uint8_t reg, uint8_t data);
+
+  //! Reset the I/O and IE registers to their defaults.
+  void resetInternal();
+
+protected:
+  //! The mapped ROM.
+  const RomImage &rom;
 
-  //! Sprite attribute table.
-  std::unique_ptr<arraySAT> SAT;
+  //! The machine state holding all RAM.
+  MachineState &state;
 
-  //! I/O registers.
-  std::unique_ptr<arrayIO> IO;
+  //! The PPU notified of VRAM and OAM writes, or nullptr.
+  PPU *ppu;
 
-  //! High RAM;
-  std::unique_ptr<arrayHR> HRAM;
+  //! The APU handling the sound registers, or nullptr.
+  APU *apu;
 
-  //! Interrupts Enable (IE) register.
-  std::unique_ptr<uint8_t> IER;
+  //! The timer handling the divider and timer registers, or nullptr.
+  Timer *timer;
 };
 
 #endif // GB_MEMORYCONTROLLER_H
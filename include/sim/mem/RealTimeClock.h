@@ -0,0 +1,127 @@
+#ifndef GB_REALTIMECLOCK_H
+#define GB_REALTIMECLOCK_H
+
+#include <cstdint>
+#include <iosfwd>
+
+/**
+ * \brief The MBC3 real time clock state.
+ *
+ * A POD so it can live in ::MachineState.
+ */
+struct RtcState {
+  //! The cycle stamp at which the counter read ::offset seconds.
+  uint64_t base;
+
+  //! The counter in seconds at ::base. Negative once 512 day periods have been
+  //! folded into the carry flag.
+  int64_t offset;
+
+  //! The cycles into the current second when the clock was halted.
+  uint64_t haltedSub;
+
+  //! Whether the clock is halted (DH bit 6).
+  bool halted;
+
+  //! The sticky day counter carry (DH bit 7).
+  bool carry;
+
+  //! The latched S, M, H, DL and DH registers.
+  uint8_t latched[5];
+};
+
+/**
+ * \brief The MBC3 real time clock.
+ *
+ * The clock is never ticked. Instead, the counter is stored as the value it
+ * had at a base cycle stamp and is computed from the simulator's cycle counter
+ * when the registers are latched or written. This makes an RTC cartridge cost
+ * nothing extra per cycle.
+ */
+class RealTimeClock {
+public:
+  //! The RTC register numbers, as selected through the MBC3 RAM bank register.
+  enum Register : uint8_t {
+    Seconds = 0x08,
+    Minutes = 0x09,
+    Hours = 0x0A,
+    DaysLow = 0x0B,
+    DaysHigh = 0x0C
+  };
+
+  //! The number of clock cycles in one RTC second.
+  constexpr static uint64_t cyclesPerSecond = 1u << 22u;
+
+  //! The size of the RTC footer appended to a battery save.
+  constexpr static std::size_t saveSize = 48;
+
+  //! RealTimeClock must be driven by a cycle counter.
+  RealTimeClock() = delete;
+
+  /**
+   * \brief Construct a clock driven by the simulator's cycle counter.
+   * \param state The clock state, which must outlive the clock.
+   * \param clock The simulator cycle counter, which must outlive the clock.
+   */
+  RealTimeClock(RtcState &state, const uint64_t &clock);
+
+  //! Reset the counter to zero and clear halt and carry.
+  void reset();
+
+  //! Latch the current counter into the readable registers.
+  void latch();
+
+  /**
+   * \brief Read a latched RTC register.
+   * \param reg The register number (0x08-0x0C).
+   * \return The latched register value.
+   */
+  uint8_t read(uint8_t reg) const;
+
+  /**
+   * \brief Write to a live RTC register.
+   * \param reg The register number (0x08-0x0C).
+   * \param value The value to write.
+   */
+  void write(uint8_t reg, uint8_t value);
+
+  /**
+   * \brief Write the RTC state in the common 48 byte save footer format.
+   *
+   * The footer holds the live and latched registers followed by the host's
+   * UNIX time, allowing the clock to catch up on wall time when reloaded.
+   */
+  void save(std::ostream &out) const;
+
+  /**
+   * \brief Load the RTC state from a 48 byte save footer.
+   *
+   * Wall time elapsed since the save is added to the counter unless the
+   * clock was halted.
+   */
+  void load(std::istream &in);
+
+private:
+  //! The current counter in seconds, with whole 512 day periods folded into
+  //! the sticky carry flag.
+  uint64_t counter();
+
+  //! The number of cycles into the current second.
+  uint64_t subSecond() const;
+
+  //! Rebase the counter so it reads \p seconds now, keeping \p sub cycles
+  //! into the current second.
+  void rebase(uint64_t seconds, uint64_t sub);
+
+  //! Split a counter value into register values.
+  static void split(uint64_t seconds, bool halted, bool carry, uint8_t regs[5]);
+
+private:
+  //! The clock state.
+  RtcState &state;
+
+  //! The simulator cycle counter.
+  const uint64_t &clock;
+};
+
+#endif // GB_REALTIMECLOCK_H
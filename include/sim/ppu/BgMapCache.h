@@ -0,0 +1,89 @@
+#ifndef GB_BGMAPCACHE_H
+#define GB_BGMAPCACHE_H
+
+#include "sim/ppu/TileCache.h"
+
+#include <cstdint>
+
+/**
+ * \brief The two 32x32 tile maps, prerendered as 256x256 colour indices.
+ *
+ * A BG or window line is then a copy out of a 256 pixel row. The maps are
+ * kept in 8x8 cells, re-rendered the next time their row is read after
+ * their map entry or the tile they show changed, so a static screen is
+ * rendered once.
+ *
+ * Tile data writes are only collected as they happen; the cells showing a
+ * written tile are found with one pass over the maps when next read, which
+ * keeps a burst of tile writes as cheap as one.
+ *
+ * Like the TileCache, writes to the VRAM the maps are rendered from must be
+ * reported through invalidate().
+ */
+class BgMapCache {
+public:
+  //! The width and height of a map in pixels.
+  constexpr static unsigned mapSize = 256;
+
+  //! Starts with every cell invalid.
+  BgMapCache() { invalidateAll(); }
+
+  /**
+   * \brief Mark what a VRAM offset is drawn into as stale.
+   * \param offset The offset into VRAM that was written.
+   */
+  void invalidate(uint16_t offset) {
+    if (offset >= TileCache::tileDataSize) {
+      unsigned cell = offset - TileCache::tileDataSize;
+      maps[cell >> 10u].dirty[(cell >> 6u) & 15u] |= 1ull << (cell & 63u);
+    }
+    else {
+      written[offset >> 10u] |= 1ull << ((offset >> 4u) & 63u);
+      tilesWritten = true;
+    }
+  }
+
+  //! Mark every cell as stale, e.g. after VRAM was replaced wholesale.
+  void invalidateAll();
+
+  /**
+   * \brief A row of a map, rendering its cells first if they are stale.
+   *
+   * \param map The map, 0 for 0x9800 or 1 for 0x9C00.
+   * \param unsignedTiles Whether tiles are addressed from 0x8000 (LCDC bit 4).
+   * \param y The row (0-255).
+   * \param vram The 8 KiB of VRAM to render from.
+   * \param tiles The decoded tiles of \p vram.
+   * \return mapSize colour indices.
+   */
+  const uint8_t *row(unsigned map, bool unsignedTiles, unsigned y, const uint8_t *vram,
+                     TileCache &tiles);
+
+private:
+  //! A prerendered map.
+  struct Map {
+    //! The colour indices.
+    alignas(64) uint8_t pixels[mapSize][mapSize];
+
+    //! One bit per cell, in map order, set if the cell must be rendered.
+    uint64_t dirty[16];
+
+    //! The tile addressing the cells were rendered with.
+    bool unsignedTiles;
+  };
+
+  //! Mark the cells showing written tiles as stale.
+  void resolveWrittenTiles(const uint8_t *vram);
+
+private:
+  //! The maps at 0x9800 and 0x9C00.
+  Map maps[2];
+
+  //! One bit per tile written since the last resolveWrittenTiles().
+  uint64_t written[TileCache::tileCount / 64];
+
+  //! Whether any bit in written is set.
+  bool tilesWritten;
+};
+
+#endif // GB_BGMAPCACHE_H
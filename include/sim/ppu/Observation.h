@@ -0,0 +1,95 @@
+#ifndef GB_OBSERVATION_H
+#define GB_OBSERVATION_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * \brief Where and how to write downscaled greyscale observations.
+ *
+ * A crop of the screen is box filtered by an integer factor and written as
+ * one byte of luminance per pixel, 0xFF for shade 0. Each composed frame
+ * fills the next slot of a caller owned ring, so the last \p slots frames
+ * are always available for stacking.
+ */
+struct ObservationSpec {
+  //! The left edge of the crop.
+  unsigned cropX = 0;
+
+  //! The top edge of the crop.
+  unsigned cropY = 0;
+
+  //! The crop width, a multiple of factor.
+  unsigned cropWidth = 160;
+
+  //! The crop height, a multiple of factor.
+  unsigned cropHeight = 144;
+
+  //! The downscale factor: 1, 2 or 4.
+  unsigned factor = 1;
+
+  //! The ring of observations, slots * width() * height() bytes.
+  uint8_t *ring = nullptr;
+
+  //! The number of observations the ring holds.
+  unsigned slots = 1;
+
+  //! The observation width in pixels.
+  unsigned width() const { return cropWidth / factor; }
+
+  //! The observation height in pixels.
+  unsigned height() const { return cropHeight / factor; }
+
+  //! The size of one observation in bytes.
+  unsigned size() const { return width() * height(); }
+};
+
+/**
+ * \brief Builds observations from composed lines.
+ *
+ * Fed each line's shades as it is composed, it filters the line into an
+ * accumulator and writes a row of the observation every factor lines, so
+ * the frame is never read back.
+ */
+class ObservationWriter {
+public:
+  /**
+   * \brief Check a specification.
+   * \return Whether \p spec describes a crop inside the screen, a supported
+   * factor and a ring.
+   */
+  static bool valid(const ObservationSpec &spec);
+
+  //! \param spec A specification that passes valid().
+  explicit ObservationWriter(const ObservationSpec &spec);
+
+  /**
+   * \brief Take a composed line.
+   *
+   * Lines are ignored until the first crop row, so a writer attached
+   * mid-frame starts with the next whole observation.
+   *
+   * \param ly The line.
+   * \param shades The line's lcd::width shades.
+   */
+  void line(unsigned ly, const uint8_t *shades);
+
+  //! The number of observations completed. The newest is in slot
+  //! (count - 1) % slots. Safe to call from any thread.
+  uint64_t count() const { return completed.load(std::memory_order_acquire); }
+
+private:
+  //! The specification.
+  ObservationSpec spec;
+
+  //! Shade sums for the observation row being built.
+  uint8_t sums[160];
+
+  //! Whether the first crop row has been seen.
+  bool started;
+
+  //! The number of observations completed.
+  std::atomic<uint64_t> completed;
+};
+
+#endif // GB_OBSERVATION_H
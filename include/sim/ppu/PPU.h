@@ -0,0 +1,334 @@
+#ifndef GB_PPU_H
+#define GB_PPU_H
+
+#include "sim/Scheduler.h"
+#include "sim/ppu/Observation.h"
+#include "sim/ppu/RasterLog.h"
+#include "sim/ppu/RenderThread.h"
+#include "sim/ppu/Renderer.h"
+#include "sim/ppu/SpriteIndex.h"
+
+#include <cstdint>
+#include <memory>
+
+struct MachineState;
+class SharedFrameSink;
+
+/**
+ * \brief The PPU timing state.
+ *
+ * A POD so it can live in ::MachineState. LY and the STAT mode bits live in
+ * the I/O registers.
+ */
+struct PpuState {
+  //! The number of frames completed since reset.
+  uint64_t frame;
+
+  //! The machine cycle count the timing was last brought up to.
+  uint64_t synced;
+
+  //! The current dot within the line (0-455), or within the frame while
+  //! the LCD is off.
+  uint32_t dot;
+
+  //! The dot at which mode 3 ends on the current line.
+  uint16_t transferEnd;
+
+  //! The current mode (0-3).
+  uint8_t mode;
+
+  //! The window's internal line counter.
+  uint8_t windowLine;
+
+  //! The level of the STAT interrupt line, interrupts fire on rising edges.
+  uint8_t statLine;
+
+  //! Whether the LCD was on at the last update.
+  uint8_t lcdOn;
+
+  //! The number of sprites selected for the current line.
+  uint8_t spriteCount;
+
+  //! The OAM indices of the sprites selected for the current line.
+  uint8_t sprites[lcd::maxLineSprites];
+};
+
+/**
+ * \brief The picture processing unit.
+ *
+ * Advances LY, STAT and the PPU mode and raises VBlank and STAT interrupts.
+ * Pixels are composed a whole line at a time at the end of mode 3, which is
+ * far cheaper than a dot-by-dot pixel FIFO and accurate for all but mid-line
+ * raster effects.
+ */
+class PPU {
+public:
+  //! PPU modes, as reported in STAT.
+  enum Mode : uint8_t {
+    HBlank = 0, VBlank = 1, OamScan = 2, Transfer = 3
+  };
+
+  //! Dots per line.
+  constexpr static unsigned lineDots = 456;
+
+  //! Dots spent in mode 2.
+  constexpr static unsigned oamScanDots = 80;
+
+  //! The minimum number of dots spent in mode 3.
+  constexpr static unsigned transferDots = 172;
+
+  //! Lines per frame, including VBlank.
+  constexpr static unsigned frameLines = 154;
+
+  //! Dots per frame.
+  constexpr static unsigned frameDots = lineDots * frameLines;
+
+  //! Where pixels are composed.
+  enum struct Compose {
+    None,   //< Nowhere: headless, only the timing is kept.
+    Inline,   //< On the calling thread, at the end of each line's mode 3.
+    Thread,   //< On a RenderThread, from snapshots taken at the end of mode 3.
+    Deferred  //< On the calling thread, a whole frame at VBlank, see RasterLog.
+  };
+
+  //! PPU must be attached to a machine.
+  PPU() = delete;
+
+  /**
+   * \brief Construct a PPU for a machine.
+   *
+   * \param state The machine state, which must outlive the PPU.
+   * \param scheduler The scheduler to register events with, which must
+   * outlive the PPU.
+   * \param compose Where to compose pixels. Compose::None never allocates
+   * anything to compose with.
+   */
+  PPU(MachineState &state, Scheduler &scheduler, Compose compose = Compose::Inline);
+
+  //! Whether the PPU was created headless.
+  bool headless() const { return renderer == nullptr && worker == nullptr; }
+
+  //! Reset the PPU timing state.
+  void reset();
+
+  /**
+   * \brief Catch up to the machine clock.
+   *
+   * LY, STAT and the interrupts only change at mode changes, so the PPU
+   * needs catching up only when its Scheduler::Ppu event is due, or before
+   * the LCD is switched on or off. Registers the next event.
+   */
+  void sync();
+
+  //! Register the next event from the timing state, e.g. after restoring a
+  //! snapshot.
+  void schedule();
+
+  /**
+   * \brief Set the framebuffer lines are composed into.
+   *
+   * Ignored by a headless PPU.
+   *
+   * \param fb The caller's framebuffer, whose pixels are nullptr to stop
+   * composing. A pitch of 0 means lines are packed.
+   */
+  void setFramebuffer(const Framebuffer &fb);
+
+  /**
+   * \brief Also write downscaled observations of each composed frame.
+   *
+   * Ignored by a headless PPU. Waits for a render thread to finish with the
+   * previous observations first.
+   *
+   * \param spec Where and how, or a spec with no ring to stop.
+   * \return false if \p spec is invalid, leaving observations off.
+   */
+  bool setObservation(const ObservationSpec &spec);
+
+  //! The number of observations written.
+  uint64_t observations() const { return observer != nullptr ? observer->count() : 0; }
+
+  /**
+   * \brief Publish composed frames to a shared memory sink.
+   *
+   * Frames are composed into the sink's framebuffer, replacing any set
+   * before, and each is published at its VBlank, before any line of the
+   * next frame is composed. Lines queued to a render thread are finished
+   * first, and detaching a sink also drops its framebuffer.
+   *
+   * \param sink The sink, which must outlive the PPU or be detached first,
+   * or nullptr to stop.
+   */
+  void attachSink(SharedFrameSink *sink);
+
+  /**
+   * \brief Wait until a render thread has composed every line queued.
+   *
+   * Lines of an unfinished frame included, so the framebuffer may be freed
+   * once this returns. Does nothing when not composing on a render thread.
+   */
+  void drain() {
+    if (worker != nullptr)
+      worker->drain();
+  }
+
+  /**
+   * \brief Skip composing pixels for some frames.
+   *
+   * Timing, registers and interrupts are unaffected; skipped frames just
+   * leave the framebuffer as it was. Of every \p period frames the first
+   * \p skip are skipped, so (7, 8) composes every eighth frame.
+   *
+   * \param skip The number of frames to skip per period, less than \p period.
+   * \param period The length of the skip pattern, in frames.
+   */
+  void setFrameSkip(unsigned skip, unsigned period);
+
+  /**
+   * \brief Whether a frame is composed under the frame skip setting.
+   * \param frame The frame number, as counted in PpuState::frame.
+   */
+  bool composes(uint64_t frame) const { return frame % skipPeriod >= skipFrames; }
+
+  /**
+   * \brief Wait until a frame is in the framebuffer.
+   *
+   * Frames are in the framebuffer at VBlank unless composed on a render
+   * thread, in which case this blocks until the thread catches up. Covers
+   * observations and the frame hash as well as the framebuffer. For a frame
+   * that was not composed, waits for the newest composed before it, which
+   * the framebuffer still holds. Returns immediately for frames that are
+   * not finished.
+   *
+   * \param frame The frame number, as counted in PpuState::frame.
+   */
+  void waitComposed(uint64_t frame) const;
+
+  /**
+   * \brief One past the number of the newest frame composed, or 0.
+   *
+   * Frames that were skipped or passed with the LCD off are not composed,
+   * so the framebuffer still holds an earlier one.
+   */
+  uint64_t lastComposed() const { return composedEnd; }
+
+  /**
+   * \brief The hash of the newest composed frame's shades.
+   *
+   * Frames that look the same have the same hash, so consumers can drop
+   * repeats without comparing pixels. Only final for a frame once
+   * waitComposed() returned for it.
+   */
+  uint64_t frameHash() const {
+    if (renderer != nullptr)
+      return renderer->frameHash();
+    return worker != nullptr ? worker->frameHash() : 0;
+  }
+
+  /**
+   * \brief Note a write to VRAM, so cached tiles can be invalidated.
+   * \param offset The offset into VRAM that was written.
+   */
+  void vramWritten(uint16_t offset) {
+    if (renderer != nullptr)
+      renderer->vramWritten(offset);
+    else if (worker != nullptr)
+      worker->vramWritten(offset);
+  }
+
+  /**
+   * \brief Note a write to an LCD register (0xFF40-0xFF4B).
+   * \param reg The register offset from 0xFF00.
+   * \param value The register's new value.
+   */
+  void lcdWritten(uint8_t reg, uint8_t value);
+
+  /**
+   * \brief Note a write to OAM.
+   * \param offset The offset into OAM that was written.
+   */
+  void oamWritten(uint8_t offset);
+
+  //! Note that all of OAM was written, e.g. by OAM DMA.
+  void oamReplaced();
+
+  //! Note that VRAM and OAM were replaced wholesale, e.g. by restoring a
+  //! snapshot.
+  void vramReplaced() {
+    oamReplaced();
+    if (renderer != nullptr)
+      renderer->vramReplaced();
+    else if (worker != nullptr)
+      worker->replaced();
+    if (rasterLog != nullptr)
+      rasterLog->invalidate();
+  }
+
+private:
+  /**
+   * \brief Advance the timing.
+   * \param cycles The number of clock cycles (dots) to advance by.
+   */
+  void advance(uint32_t cycles);
+
+  //! Switch mode, updating STAT and the STAT interrupt line.
+  void enterMode(Mode mode);
+
+  //! Select the sprites for the current line and start mode 2.
+  void startLine();
+
+  //! Whether the current frame goes anywhere.
+  bool composing() const;
+
+  //! Compose the current line into the framebuffer.
+  void renderLine();
+
+  //! Publish the frame just completed to the sink and move to its next slot.
+  void publish();
+
+  //! Update the LY=LYC flag and the STAT interrupt line.
+  void updateStat();
+
+  //! Request an interrupt by IF bit.
+  void interrupt(uint8_t bit);
+
+private:
+  //! The machine state.
+  MachineState &state;
+
+  //! The scheduler the next mode change is registered with.
+  Scheduler &scheduler;
+
+  //! The sprites on each line, for selecting a line's sprites.
+  SpriteIndex spriteIndex;
+
+  //! The line compositor, if composing inline or deferred.
+  std::unique_ptr<Renderer> renderer;
+
+  //! The frame's register writes, if composing deferred.
+  std::unique_ptr<RasterLog> rasterLog;
+
+  //! The observation writer, or nullptr. Outlives the render thread, which
+  //! finishes queued lines as it stops.
+  std::unique_ptr<ObservationWriter> observer;
+
+  //! The render thread, if composing on one.
+  std::unique_ptr<RenderThread> worker;
+
+  //! The caller's framebuffer.
+  Framebuffer framebuffer;
+
+  //! The shared memory frame sink, or nullptr.
+  SharedFrameSink *sink;
+
+  //! Frames skipped per period.
+  unsigned skipFrames;
+
+  //! The frame skip period.
+  unsigned skipPeriod;
+
+  //! One past the newest frame composed.
+  uint64_t composedEnd;
+};
+
+#endif // GB_PPU_H
@@ -0,0 +1,57 @@
+#ifndef GB_PIXELFORMAT_H
+#define GB_PIXELFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+//! Framebuffer pixel formats.
+enum struct PixelFormat : uint8_t {
+  Index8,  //< One byte per pixel holding the shade, 0 (lightest) to 3.
+  Gray8,   //< One byte of luminance per pixel, 0xFF for shade 0.
+  RGB565,  //< 16 bits per pixel, native endian.
+  RGBA8888 //< Bytes R, G, B, A in memory order.
+};
+
+//! Namespace holding pixel format conversions.
+namespace pixelfmt {
+
+//! The size of a pixel in a format.
+constexpr unsigned bytesPerPixel(PixelFormat format) {
+  return format == PixelFormat::RGBA8888 ? 4u : format == PixelFormat::RGB565 ? 2u : 1u;
+}
+
+/**
+ * \brief Convert shades to a pixel format.
+ *
+ * Shades map onto an even grey ramp: 0xFF, 0xAA, 0x55 and 0x00.
+ *
+ * \param format The format to write.
+ * \param shades \p count shades (0-3).
+ * \param count The number of pixels.
+ * \param out \p count pixels in \p format. Needs no particular alignment.
+ */
+void convert(PixelFormat format, const uint8_t *shades, unsigned count, void *out);
+
+} // End namespace pixelfmt.
+
+/**
+ * \brief Caller owned memory that frames are composed into.
+ *
+ * Lines are written straight into it in the requested format, so consumers
+ * need no conversion pass of their own.
+ */
+struct Framebuffer {
+  //! The first pixel of the first line, or nullptr for no output.
+  uint8_t *pixels = nullptr;
+
+  //! The format of each pixel.
+  PixelFormat format = PixelFormat::Index8;
+
+  //! The distance between the start of each line in bytes.
+  std::size_t pitch = 0;
+
+  //! The start of a line.
+  uint8_t *line(unsigned ly) const { return pixels + ly * pitch; }
+};
+
+#endif // GB_PIXELFORMAT_H
@@ -0,0 +1,104 @@
+#ifndef GB_RASTERLOG_H
+#define GB_RASTERLOG_H
+
+#include "sim/ppu/Observation.h"
+#include "sim/ppu/Renderer.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Records a frame's LCD register writes so it can be composed at once.
+ *
+ * The registers are captured at the start of the frame, then every write to
+ * 0xFF40-0xFF4B is logged in order. Each line notes how many writes preceded
+ * the end of its mode 3, which is when it would have been composed, along
+ * with its sprites. replay() then composes every line with exactly the
+ * registers it would have seen, in one pass with a hot cache.
+ *
+ * VRAM and OAM are not logged: a frame is composed from their contents at
+ * VBlank, so mid-frame tile or sprite data changes show up a frame early.
+ */
+class RasterLog {
+public:
+  //! A register write.
+  struct Event {
+    //! The register offset from 0xFF00.
+    uint8_t reg;
+
+    //! The value written.
+    uint8_t value;
+  };
+
+  RasterLog();
+
+  /**
+   * \brief Start logging a frame.
+   * \param io The I/O registers at the start of the frame.
+   */
+  void begin(const uint8_t *io);
+
+  /**
+   * \brief Log a register write.
+   * \param reg The register offset from 0xFF00, 0x40-0x4B.
+   * \param value The value written.
+   */
+  void record(uint8_t reg, uint8_t value) {
+    if (valid)
+      events.push_back({reg, value});
+  }
+
+  /**
+   * \brief Note that a line reached the end of mode 3.
+   *
+   * \param ly The line.
+   * \param sprites The OAM indices of the line's sprites.
+   * \param spriteCount The number of sprites.
+   */
+  void markLine(uint8_t ly, const uint8_t *sprites, unsigned spriteCount);
+
+  //! Drop the frame being logged, e.g. after the machine state was replaced.
+  void invalidate() { valid = false; }
+
+  /**
+   * \brief Compose the logged frame.
+   *
+   * Does nothing unless the whole frame, from its first line, was logged.
+   *
+   * \param renderer The compositor.
+   * \param vram The 8 KiB of VRAM.
+   * \param oam The 160 bytes of OAM.
+   * \param framebuffer The frame to write, which may have no pixels.
+   * \param observer Fed each composed line, or nullptr.
+   * \return Whether the frame was composed.
+   */
+  bool replay(Renderer &renderer, const uint8_t *vram, const uint8_t *oam,
+              const Framebuffer &framebuffer, ObservationWriter *observer);
+
+private:
+  //! A line's place in the log.
+  struct LineMark {
+    //! The number of events logged before the line was composed.
+    uint32_t events;
+
+    uint8_t spriteCount;
+    uint8_t sprites[lcd::maxLineSprites];
+  };
+
+  //! The LCD registers (0xFF40-0xFF4B) at the start of the frame.
+  uint8_t start[12];
+
+  //! The frame's register writes, in order.
+  std::vector<Event> events;
+
+  //! Each visible line's place in the log.
+  LineMark lines[lcd::height];
+
+  //! The number of lines marked.
+  unsigned marked;
+
+  //! Whether the log covers the frame from its start.
+  bool valid;
+};
+
+#endif // GB_RASTERLOG_H
@@ -0,0 +1,176 @@
+#ifndef GB_RENDERTHREAD_H
+#define GB_RENDERTHREAD_H
+
+#include "sim/ppu/Observation.h"
+#include "sim/ppu/Renderer.h"
+#include "sim/util/SpscRing.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+/**
+ * \brief A unit of work for the render thread.
+ *
+ * Either a copy of a dirty 32 byte block of VRAM or OAM, the inputs for one
+ * line, the end of a frame, or a fence the emulation thread waits on.
+ */
+struct RenderCommand {
+  enum Kind : uint8_t {
+    Vram,  //< Update the shadow VRAM.
+    Oam,   //< Update the shadow OAM.
+    Line,  //< Compose a line.
+    Frame, //< All lines of a frame have been sent.
+    Fence  //< Everything before has been applied.
+  };
+
+  //! The size of a VRAM or OAM update.
+  constexpr static unsigned blockSize = 32;
+
+  Kind kind;
+
+  union {
+    //! Vram and Oam.
+    struct {
+      uint16_t offset;
+      uint8_t bytes[blockSize];
+    } update;
+
+    //! Line.
+    struct {
+      LineRegs regs;
+      uint8_t spriteCount;
+      uint8_t sprites[lcd::maxLineSprites];
+      PixelFormat format;
+      uint8_t *out;
+      ObservationWriter *observer;
+    } line;
+
+    //! Frame: the number of the frame that ended.
+    uint64_t frame;
+
+    //! Fence: its sequence number.
+    uint64_t fence;
+  };
+};
+
+/**
+ * \brief Composes lines on a second thread.
+ *
+ * The emulation thread records which blocks of VRAM and OAM change and, for
+ * each line, sends the changed blocks followed by the line's registers. The
+ * render thread applies the changes to its own shadow copies of VRAM and
+ * OAM and composes from those, so it never reads memory the emulation
+ * thread is writing.
+ *
+ * Queued lines hold the caller's framebuffer and observation writer, which
+ * must stay alive until drain() or the destructor returns.
+ *
+ * All members but composedFrames(), waitFrames() and frameHash() belong to
+ * the emulation thread.
+ */
+class RenderThread {
+public:
+  //! Start the render thread.
+  RenderThread();
+
+  //! Compose any queued lines, then stop the render thread.
+  ~RenderThread();
+
+  RenderThread(const RenderThread &) = delete;
+  RenderThread &operator=(const RenderThread &) = delete;
+
+  //! Record a write to VRAM.
+  void vramWritten(uint16_t offset) {
+    vramDirty[offset >> 11u] |= 1ull << ((offset >> 5u) & 63u);
+  }
+
+  //! Record a write to OAM.
+  void oamWritten() { oamDirty = true; }
+
+  //! Mark all of VRAM and OAM as changed.
+  void replaced();
+
+  /**
+   * \brief Queue a line to be composed.
+   *
+   * \param vram The emulation thread's VRAM, to send changed blocks from.
+   * \param oam The emulation thread's OAM, to send changed blocks from.
+   * \param regs The line's registers.
+   * \param sprites The OAM indices of the line's sprites.
+   * \param spriteCount The number of sprites.
+   * \param out Where to compose the line's lcd::width pixels, or nullptr.
+   * \param format The format of \p out.
+   * \param observer Fed the line on the render thread, or nullptr.
+   */
+  void line(const uint8_t *vram, const uint8_t *oam, const LineRegs &regs,
+            const uint8_t *sprites, unsigned spriteCount, uint8_t *out, PixelFormat format,
+            ObservationWriter *observer);
+
+  /**
+   * \brief Mark the end of a frame's lines.
+   * \param frame The frame's number, as counted in PpuState::frame.
+   */
+  void endFrame(uint64_t frame);
+
+  //! One past the number of the last frame composed in full.
+  uint64_t composedFrames() const { return composed.load(std::memory_order_acquire); }
+
+  //! Block until composedFrames() reaches \p frames.
+  void waitFrames(uint64_t frames) const;
+
+  //! Block until everything queued, including lines of an unfinished
+  //! frame, has been applied.
+  void drain();
+
+  //! The hash of the last frame composed in full, see Renderer::frameHash().
+  uint64_t frameHash() const { return renderer.frameHash(); }
+
+private:
+  //! Queue a command, waiting for space if the render thread is behind.
+  void send(const RenderCommand &command);
+
+  //! Queue the dirty VRAM and OAM blocks.
+  void flush(const uint8_t *vram, const uint8_t *oam);
+
+  //! The render thread's loop.
+  void work();
+
+  //! Apply a single command.
+  void apply(const RenderCommand &command);
+
+private:
+  //! Queued commands, enough for a full VRAM and OAM upload several times over.
+  std::unique_ptr<SpscRing<RenderCommand, 4096>> ring;
+
+  //! One bit per 32 byte VRAM block changed since it was last sent.
+  uint64_t vramDirty[4];
+
+  //! Whether OAM changed since it was last sent.
+  bool oamDirty;
+
+  //! One past the last frame composed by the render thread.
+  std::atomic<uint64_t> composed;
+
+  //! The fences sent, and the last one the render thread reached.
+  uint64_t fences;
+  std::atomic<uint64_t> fenced;
+
+  //! Cleared to stop the render thread.
+  std::atomic<bool> running;
+
+  //! The render thread's copy of VRAM.
+  uint8_t shadowVram[1u << 13u];
+
+  //! The render thread's copy of OAM.
+  uint8_t shadowOam[160];
+
+  //! The render thread's compositor.
+  Renderer renderer;
+
+  //! The render thread.
+  std::thread thread;
+};
+
+#endif // GB_RENDERTHREAD_H
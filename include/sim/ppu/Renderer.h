@@ -0,0 +1,170 @@
+#ifndef GB_RENDERER_H
+#define GB_RENDERER_H
+
+#include "sim/ppu/BgMapCache.h"
+#include "sim/ppu/PixelFormat.h"
+#include "sim/ppu/TileCache.h"
+
+#include <atomic>
+#include <cstdint>
+
+//! LCD register addresses and bits.
+namespace lcd {
+
+//! The screen width in pixels.
+constexpr unsigned width = 160;
+
+//! The screen height in pixels.
+constexpr unsigned height = 144;
+
+//! LCD register offsets into the I/O registers.
+enum Reg : uint8_t {
+  LCDC = 0x40, STAT = 0x41, SCY = 0x42, SCX = 0x43, LY = 0x44, LYC = 0x45,
+  DMA = 0x46, BGP = 0x47, OBP0 = 0x48, OBP1 = 0x49, WY = 0x4A, WX = 0x4B
+};
+
+//! LCDC bits.
+enum Lcdc : uint8_t {
+  BgEnable = 0x01,     //< BG and window enable.
+  ObjEnable = 0x02,    //< Sprite enable.
+  ObjSize = 0x04,      //< 8x16 sprites.
+  BgMap = 0x08,        //< BG tile map at 0x9C00 rather than 0x9800.
+  TileData = 0x10,     //< Unsigned tile data at 0x8000 rather than signed at 0x8800.
+  WindowEnable = 0x20, //< Window enable.
+  WindowMap = 0x40,    //< Window tile map at 0x9C00 rather than 0x9800.
+  LcdEnable = 0x80     //< LCD and PPU enable.
+};
+
+//! Sprite attribute flag bits.
+enum ObjFlags : uint8_t {
+  Palette = 0x10,   //< Use OBP1 rather than OBP0.
+  XFlip = 0x20,     //< Flip horizontally.
+  YFlip = 0x40,     //< Flip vertically.
+  BgPriority = 0x80 //< BG colours 1-3 are drawn over the sprite.
+};
+
+//! The maximum number of sprites on one line.
+constexpr unsigned maxLineSprites = 10;
+
+} // End namespace lcd.
+
+/**
+ * \brief The PPU inputs that affect composing a single line.
+ *
+ * A POD snapshot of the LCD registers plus the PPU's internal window line
+ * counter, taken when the line is rendered.
+ */
+struct LineRegs {
+  uint8_t lcdc;
+  uint8_t scy;
+  uint8_t scx;
+  uint8_t wy;
+  uint8_t wx;
+  uint8_t bgp;
+  uint8_t obp0;
+  uint8_t obp1;
+
+  //! The line being rendered.
+  uint8_t ly;
+
+  //! The window's internal line counter.
+  uint8_t windowLine;
+};
+
+/**
+ * \brief Composes background, window and sprites for one line.
+ *
+ * The renderer holds no machine state, it is handed the registers, VRAM and
+ * OAM to compose from, so it can run on whatever copy of them is current.
+ * It does cache decoded tiles and prerendered tile maps, so writes to that
+ * VRAM must be reported through vramWritten().
+ */
+class Renderer {
+public:
+  /**
+   * \brief Compose one line.
+   *
+   * \param regs The LCD registers for the line.
+   * \param vram The 8 KiB of VRAM.
+   * \param oam The 160 bytes of OAM.
+   * \param sprites The OAM indices of the line's sprites, in OAM order.
+   * \param spriteCount The number of sprites, at most lcd::maxLineSprites.
+   * \param out The lcd::width pixels to write, or nullptr to only compose
+   * the shades.
+   * \param format The format of \p out.
+   * \return The line's shades, valid until the next call.
+   */
+  const uint8_t *renderLine(const LineRegs &regs, const uint8_t *vram, const uint8_t *oam,
+                            const uint8_t *sprites, unsigned spriteCount, uint8_t *out,
+                            PixelFormat format = PixelFormat::Index8);
+
+  /**
+   * \brief The hash of the shades of the last frame composed in full.
+   *
+   * Lines are hashed as they are composed, so equal hashes mean identical
+   * pictures, whatever the pixel format, without reading the frame back.
+   * Safe to call from any thread.
+   */
+  uint64_t frameHash() const { return lastFrameHash.load(std::memory_order_acquire); }
+
+  /**
+   * \brief Whether the window covers part of a line.
+   * \param regs The LCD registers for the line.
+   */
+  static bool windowVisible(const LineRegs &regs) {
+    return (regs.lcdc & (lcd::WindowEnable | lcd::BgEnable)) == (lcd::WindowEnable | lcd::BgEnable) &&
+           regs.ly >= regs.wy && regs.wx < lcd::width + 7;
+  }
+
+  /**
+   * \brief Invalidate the cached tile or map cell holding a VRAM offset.
+   * \param offset The offset into VRAM that was written.
+   */
+  void vramWritten(uint16_t offset) {
+    tiles.invalidate(offset);
+    maps.invalidate(offset);
+  }
+
+  //! Invalidate everything cached, after VRAM was replaced wholesale.
+  void vramReplaced() {
+    tiles.invalidateAll();
+    maps.invalidateAll();
+  }
+
+private:
+  //! Write the BG (and window) colour indices for a line.
+  void renderBackground(const LineRegs &regs, const uint8_t *vram);
+
+  //! Write the sprite colour indices and attributes for a line.
+  void renderSprites(const LineRegs &regs, const uint8_t *vram, const uint8_t *oam,
+                     const uint8_t *sprites, unsigned spriteCount);
+
+private:
+  //! Decoded tiles.
+  TileCache tiles;
+
+  //! Prerendered tile maps.
+  BgMapCache maps;
+
+  //! BG/window colour indices.
+  uint8_t bgLine[lcd::width];
+
+  //! Sprite pixels left of the screen, so sprites are drawn unclipped.
+  constexpr static unsigned objMargin = 8;
+
+  //! Sprite pixels: colour index, palette and BG priority bits, 0 where no
+  //! sprite is opaque. Pixel x is at objMargin + x; a sprite at OAM X
+  //! covers objLine[X] to objLine[X + 7], so the margins take X up to 255.
+  uint8_t objLine[objMargin + 256];
+
+  //! Mixed shades, unless written straight to a PixelFormat::Index8 line.
+  alignas(16) uint8_t shadeLine[lcd::width];
+
+  //! The hash of the frame being composed, up to the last line.
+  uint64_t frameHashSoFar = 0;
+
+  //! The hash of the last frame composed in full.
+  std::atomic<uint64_t> lastFrameHash {0};
+};
+
+#endif // GB_RENDERER_H
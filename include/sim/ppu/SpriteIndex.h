@@ -0,0 +1,77 @@
+#ifndef GB_SPRITEINDEX_H
+#define GB_SPRITEINDEX_H
+
+#include "sim/ppu/Renderer.h"
+
+#include <cstdint>
+
+/**
+ * \brief The sprites on each visible line, kept up to date with OAM.
+ *
+ * Each line has a mask of the OAM entries that overlap it, one for 8x8 and
+ * one for 8x16 sprites, so a line's sprites are read off its mask in OAM
+ * order rather than found by testing all 40 entries. Only writes to a
+ * sprite's Y byte move it between lines.
+ *
+ * Like the TileCache, the index never reads OAM on its own; whoever writes
+ * the OAM it is used with must report writes through written() or rebuild().
+ */
+class SpriteIndex {
+public:
+  //! The number of sprites in OAM.
+  constexpr static unsigned spriteCount = 40;
+
+  //! Starts indexing an OAM full of sprites at Y = 0, i.e. off screen.
+  SpriteIndex();
+
+  /**
+   * \brief Index OAM from scratch, e.g. after OAM DMA.
+   * \param oam The 160 bytes of OAM.
+   */
+  void rebuild(const uint8_t *oam);
+
+  /**
+   * \brief Note a write to OAM.
+   * \param offset The offset into OAM that was written.
+   * \param oam The 160 bytes of OAM, after the write.
+   */
+  void written(uint8_t offset, const uint8_t *oam) {
+    if (offset % 4u == 0 && oam[offset] != ys[offset / 4u])
+      move(offset / 4u, oam[offset]);
+  }
+
+  /**
+   * \brief Select the sprites the PPU draws on a line.
+   *
+   * \param ly The line, below lcd::height.
+   * \param tall Whether sprites are 8x16.
+   * \param sprites Receives the OAM indices of the first lcd::maxLineSprites
+   * sprites overlapping the line, in OAM order.
+   * \return The number of sprites selected.
+   */
+  unsigned select(unsigned ly, bool tall, uint8_t *sprites) const {
+    uint64_t mask = lines[tall][ly];
+    unsigned count = 0;
+    while (mask != 0 && count < lcd::maxLineSprites) {
+      sprites[count++] = static_cast<uint8_t>(__builtin_ctzll(mask));
+      mask &= mask - 1u;
+    }
+    return count;
+  }
+
+private:
+  //! Move a sprite to the lines covered from Y position \p y.
+  void move(unsigned sprite, uint8_t y);
+
+  //! Set or clear a sprite's bit on the lines it covers from Y position \p y.
+  void mark(unsigned sprite, uint8_t y, bool on);
+
+private:
+  //! For 8x8 then 8x16 sprites, a mask of the sprites on each line.
+  uint64_t lines[2][lcd::height];
+
+  //! The Y position each sprite is indexed at.
+  uint8_t ys[spriteCount];
+};
+
+#endif // GB_SPRITEINDEX_H
@@ -0,0 +1,90 @@
+#ifndef GB_TILECACHE_H
+#define GB_TILECACHE_H
+
+#include <cstdint>
+
+/**
+ * \brief Decoded copies of the 384 tiles in VRAM.
+ *
+ * Each tile is kept as 64 colour indices, row by row. A tile is decoded the
+ * first time it is drawn after its 16 bytes in VRAM were written, so tiles
+ * that don't change are decoded once however often they are drawn.
+ *
+ * The cache never reads VRAM on its own; whoever writes the VRAM it is used
+ * with must report writes through invalidate().
+ */
+class TileCache {
+public:
+  //! The number of tiles in a VRAM bank.
+  constexpr static unsigned tileCount = 384;
+
+  //! The VRAM offset the tile maps start at, past the tile data.
+  constexpr static unsigned tileDataSize = tileCount * 16;
+
+  /**
+   * \brief The tile a BG or window map entry shows.
+   * \param entry The map entry.
+   * \param unsignedTiles Whether tiles are addressed from 0x8000 (LCDC bit 4)
+   * rather than signed from 0x9000.
+   */
+  static unsigned mapTile(uint8_t entry, bool unsignedTiles) {
+    if (unsignedTiles)
+      return entry;
+    return static_cast<unsigned>(256 + static_cast<int8_t>(entry));
+  }
+
+  //! Starts with every tile invalid.
+  TileCache() { invalidateAll(); }
+
+  /**
+   * \brief Mark the tile holding a VRAM offset as stale.
+   * \param offset The offset into VRAM that was written.
+   */
+  void invalidate(uint16_t offset) {
+    if (offset < tileDataSize)
+      dirty[offset >> 10u] |= 1ull << ((offset >> 4u) & 63u);
+  }
+
+  //! Mark every tile as stale, e.g. after VRAM was replaced wholesale.
+  void invalidateAll() {
+    for (uint64_t &word : dirty)
+      word = ~0ull;
+  }
+
+  /**
+   * \brief A decoded tile, decoding it first if it is stale.
+   *
+   * \param index The tile index (0-383), i.e. its VRAM offset / 16.
+   * \param vram The 8 KiB of VRAM to decode from.
+   * \return 64 colour indices, 8 per row, leftmost pixel first.
+   */
+  const uint8_t *tile(unsigned index, const uint8_t *vram) {
+    uint64_t bit = 1ull << (index & 63u);
+    if (dirty[index >> 6u] & bit) {
+      decode(index, vram);
+      dirty[index >> 6u] &= ~bit;
+    }
+    return tiles[index];
+  }
+
+  /**
+   * \brief One decoded row of a tile.
+   * \see tile()
+   */
+  const uint8_t *row(unsigned index, unsigned row, const uint8_t *vram) {
+    return tile(index, vram) + row * 8u;
+  }
+
+private:
+  //! Decode a single tile from VRAM.
+  void decode(unsigned index, const uint8_t *vram);
+
+private:
+  //! The decoded tiles.
+  alignas(64) uint8_t tiles[tileCount][64];
+
+  //! One bit per tile, set if the tile must be decoded before use.
+  uint64_t dirty[tileCount / 64];
+};
+
+#endif // GB_TILECACHE_H
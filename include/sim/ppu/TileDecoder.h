@@ -0,0 +1,64 @@
+#ifndef GB_TILEDECODER_H
+#define GB_TILEDECODER_H
+
+#include <cstdint>
+
+/**
+ * \brief Decodes 2bpp planar tile rows into colour indices.
+ *
+ * A tile row is two bytes, the low and high bit planes, with the leftmost
+ * pixel in bit 7. Rows are decoded in batches so callers gather every row a
+ * line needs and decode them in one call. The implementation is picked once,
+ * at startup, from the host's CPU features.
+ */
+class TileDecoder {
+public:
+  //! Decoder implementations.
+  enum struct Impl {
+    Scalar, //< Table lookup.
+    SSE2,   //< Two rows per iteration.
+    BMI2,   //< One row per PDEP pair.
+    AVX2    //< Four rows per iteration.
+  };
+
+  /**
+   * \brief Decode a batch of tile rows.
+   *
+   * \param planes \p rows pairs of (low, high) plane bytes. A whole tile is
+   * eight consecutive pairs, exactly as it is laid out in VRAM.
+   * \param rows The number of rows.
+   * \param out 8 * \p rows colour indices (0-3), leftmost pixel first.
+   */
+  static void decode(const uint8_t *planes, unsigned rows, uint8_t *out) {
+    decoder(planes, rows, out);
+  }
+
+  //! The implementation in use.
+  static Impl impl() { return selected; }
+
+  //! The name of the implementation in use, for logging.
+  static const char *name();
+
+  /**
+   * \brief Decode with a specific implementation.
+   *
+   * For benchmarking and cross-checking, \p impl must be supported by the
+   * host.
+   */
+  static void decodeWith(Impl impl, const uint8_t *planes, unsigned rows, uint8_t *out);
+
+  //! Whether the host supports an implementation.
+  static bool supported(Impl impl);
+
+private:
+  //! A decoder entry point.
+  using DecodeFn = void (*)(const uint8_t *, unsigned, uint8_t *);
+
+  //! The selected implementation.
+  static const Impl selected;
+
+  //! The selected entry point.
+  static const DecodeFn decoder;
+};
+
+#endif // GB_TILEDECODER_H
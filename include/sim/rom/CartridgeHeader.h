@@ -0,0 +1,86 @@
+#ifndef GB_CARTRIDGEHEADER_H
+#define GB_CARTRIDGEHEADER_H
+
+#include <cstddef>
+#include <cstdint>
+
+//! The memory bank controller family a cartridge type uses.
+enum struct Mapper : uint8_t {
+  None = 0, MBC1 = 1, MBC2 = 2, MBC3 = 3, MBC5 = 5, Other = 0xFF
+};
+
+/**
+ * \brief The parsed and validated cartridge header (0x0100-0x014F).
+ *
+ * This is a POD so it can be stored as-is in the ROM library index.
+ */
+struct CartridgeHeader {
+  //! Validation results, as bits of ::flags.
+  enum Flag : uint8_t {
+    HeaderChecksumOk = 0x01, //< Header checksum (0x014D) matches.
+    GlobalChecksumOk = 0x02, //< Global checksum (0x014E-0x014F) matches.
+    LogoOk = 0x04,           //< Nintendo logo (0x0104-0x0133) matches.
+    SizeOk = 0x08,           //< ROM size code matches the image size.
+    Timer = 0x10,            //< Cartridge has an RTC.
+    Battery = 0x20,          //< Cartridge has battery backed state.
+    CGB = 0x40               //< Cartridge supports CGB features.
+  };
+
+  //! The offset of the header in the ROM.
+  constexpr static std::size_t offset = 0x100;
+
+  //! The number of ROM bytes needed to parse the header.
+  constexpr static std::size_t end = 0x150;
+
+  //! The title, NUL padded (and terminated).
+  char title[17];
+
+  //! The cartridge type byte (0x0147).
+  uint8_t type;
+
+  //! The ROM size code (0x0148).
+  uint8_t romSizeCode;
+
+  //! The RAM size code (0x0149).
+  uint8_t ramSizeCode;
+
+  //! The mask ROM version number (0x014C).
+  uint8_t version;
+
+  //! The header checksum (0x014D).
+  uint8_t headerChecksum;
+
+  //! The global checksum (0x014E-0x014F), big endian in the ROM.
+  uint16_t globalChecksum;
+
+  //! The mapper family for ::type.
+  Mapper mapper;
+
+  //! Validation and feature ::Flag bits.
+  uint8_t flags;
+
+  //! The ROM size in bytes given by ::romSizeCode, 0 if the code is invalid.
+  uint32_t romSize;
+
+  //! The external RAM size in bytes given by ::ramSizeCode and ::type.
+  uint32_t ramSize;
+
+  /**
+   * \brief Parse and validate the header of a ROM image.
+   *
+   * \param rom The ROM image. Must be at least ::end bytes for the header to
+   * be parsed; the whole image is needed to verify the global checksum.
+   * \param size The size of \p rom.
+   * \param header The header to fill.
+   * \return False if the image is too small to hold a header.
+   */
+  static bool parse(const uint8_t *rom, std::size_t size, CartridgeHeader &header);
+
+  //! Whether all of the \p mask flags are set.
+  bool has(uint8_t mask) const { return (flags & mask) == mask; }
+
+  //! Whether the checksums and size were all valid.
+  bool valid() const { return has(HeaderChecksumOk | GlobalChecksumOk | SizeOk); }
+};
+
+#endif // GB_CARTRIDGEHEADER_H
@@ -0,0 +1,61 @@
+#ifndef GB_ROMIMAGE_H
+#define GB_ROMIMAGE_H
+
+#include "sim/rom/CartridgeHeader.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \brief An immutable, loaded ROM image.
+ *
+ * Images are shared between every simulator running the same cartridge, so
+ * only one copy of the ROM lives in memory no matter how many instances run.
+ */
+class RomImage {
+public:
+  //! The size of a ROM bank.
+  constexpr static std::size_t bankSize = 1u << 14u;
+
+  /**
+   * \brief Load and validate the ROM located at the filepath provided.
+   *
+   * The image is padded with 0xFF to a whole number of banks, at least two.
+   *
+   * \param romLoc The filepath for the ROM.
+   * \return The image, or nullptr if the ROM failed to open or has no header.
+   */
+  static std::shared_ptr<const RomImage> load(const char *romLoc);
+
+  //! The filepath the image was loaded from.
+  const std::string &path() const { return romPath; }
+
+  //! The parsed cartridge header.
+  const CartridgeHeader &header() const { return cartHeader; }
+
+  //! The size of the ROM file, before padding.
+  std::size_t size() const { return fileSize; }
+
+  //! The number of banks in the (padded) image.
+  std::size_t bankCount() const { return bytes.size() / bankSize; }
+
+  //! The start of bank \p n, wrapping around the bank count.
+  const uint8_t *bank(std::size_t n) const { return bytes.data() + (n % bankCount()) * bankSize; }
+
+private:
+  //! The filepath the image was loaded from.
+  std::string romPath;
+
+  //! The parsed cartridge header.
+  CartridgeHeader cartHeader;
+
+  //! The size of the ROM file, before padding.
+  std::size_t fileSize;
+
+  //! The image bytes.
+  std::vector<uint8_t> bytes;
+};
+
+#endif // GB_ROMIMAGE_H
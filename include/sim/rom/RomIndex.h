@@ -0,0 +1,133 @@
+#ifndef GB_ROMINDEX_H
+#define GB_ROMINDEX_H
+
+#include "sim/rom/CartridgeHeader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \brief A compact, on-disk index of a ROM library.
+ *
+ * Building the index maps every ROM in parallel, parses and validates its
+ * header and hashes its content. The index is written as a flat binary file
+ * of fixed size entries sorted by path hash, followed by a string table, so
+ * opening it is a single mmap and a lookup is a binary search. Schedulers can
+ * then pick a controller type and memory budget without opening any ROM.
+ */
+class RomIndex {
+public:
+  //! One indexed ROM. Stored as-is in the index file.
+  struct Entry {
+    //! The hash of the ROM path, the sort key.
+    uint64_t pathHash;
+
+    //! The hash of the ROM content.
+    uint64_t contentHash;
+
+    //! The ROM file modification time, in seconds since the epoch.
+    int64_t mtime;
+
+    //! The ROM file size in bytes.
+    uint32_t fileSize;
+
+    //! The offset of the path in the string table.
+    uint32_t pathOffset;
+
+    //! The length of the path, not including the NUL terminator.
+    uint32_t pathLength;
+
+    //! The parsed cartridge header.
+    CartridgeHeader header;
+  };
+
+  //! Create an empty index.
+  RomIndex();
+
+  //! RomIndex owns a mapping and can't be copied.
+  RomIndex(const RomIndex &) = delete;
+
+  //! Move the index (and its mapping).
+  RomIndex(RomIndex &&other) noexcept;
+
+  //! Unmap the index file, if mapped.
+  ~RomIndex();
+
+  /**
+   * \brief Build an index of ROM files.
+   *
+   * Directories are searched recursively for .gb and .gbc files. Files that
+   * fail to open or are too small to hold a header are logged and skipped.
+   *
+   * \param paths The ROM files and directories to index.
+   * \param threads The number of worker threads, 0 for the hardware count.
+   * \return The built index.
+   */
+  static RomIndex build(const std::vector<std::string> &paths, unsigned threads = 0);
+
+  /**
+   * \brief Write the index to a file.
+   * \param path The filepath to write to.
+   * \return Whether the write succeeded.
+   */
+  bool save(const char *path) const;
+
+  /**
+   * \brief Open an index written by save().
+   *
+   * The file is mapped rather than read, so this takes microseconds
+   * regardless of the library size.
+   *
+   * \param path The filepath to open.
+   * \return Whether the file was a valid index.
+   */
+  bool open(const char *path);
+
+  /**
+   * \brief Find the entry for a ROM path.
+   * \param path The ROM path, exactly as it was indexed.
+   * \return The entry, or nullptr if the path isn't indexed.
+   */
+  const Entry *find(const std::string &path) const;
+
+  //! The path of an entry.
+  const char *path(const Entry &entry) const { return strings + entry.pathOffset; }
+
+  //! The number of entries.
+  std::size_t size() const { return count; }
+
+  //! The entries, sorted by path hash.
+  const Entry *begin() const { return entries; }
+
+  //! One past the last entry.
+  const Entry *end() const { return entries + count; }
+
+private:
+  //! Drop any mapping and owned storage.
+  void clear();
+
+private:
+  //! The entries, either owned or in the mapping.
+  const Entry *entries;
+
+  //! The number of entries.
+  std::size_t count;
+
+  //! The string table, either owned or in the mapping.
+  const char *strings;
+
+  //! The index file mapping, if opened.
+  void *map;
+
+  //! The size of ::map.
+  std::size_t mapSize;
+
+  //! Entry storage for built indices.
+  std::vector<Entry> ownedEntries;
+
+  //! String table storage for built indices.
+  std::string ownedStrings;
+};
+
+#endif // GB_ROMINDEX_H
@@ -0,0 +1,113 @@
+#ifndef GB_TIMER_H
+#define GB_TIMER_H
+
+#include "sim/Scheduler.h"
+
+#include <cstdint>
+
+struct MachineState;
+
+//! Timer register addresses.
+namespace tmr {
+
+//! Timer register offsets into the I/O registers.
+enum Reg : uint8_t {
+  DIV = 0x04, TIMA = 0x05, TMA = 0x06, TAC = 0x07, End = 0x08
+};
+
+//! TAC bits.
+enum Tac : uint8_t {
+  Clock = 0x03,  //< The TIMA clock select.
+  Enable = 0x04  //< TIMA enable.
+};
+
+} // End namespace tmr.
+
+/**
+ * \brief The timer state.
+ *
+ * A POD so it can live in ::MachineState. TIMA, TMA and TAC live in the I/O
+ * registers; DIV is derived from the cycle count.
+ */
+struct TimerState {
+  //! The machine cycle count at which the divider was last 0, modulo 2^64.
+  uint64_t divBase;
+
+  //! The machine cycle count TIMA was last brought up to.
+  uint64_t synced;
+};
+
+/**
+ * \brief The divider and timer (0xFF04-0xFF07).
+ *
+ * Nothing is counted per clock. The 16 bit divider, whose high byte is DIV,
+ * is the cycle count since it was last reset. TIMA counts falling edges of
+ * the divider bit TAC selects, so it is caught up from the divider when
+ * read or when the timer registers are written. Only the overflow, which
+ * reloads TIMA from TMA and requests the timer interrupt, is registered
+ * with the scheduler.
+ *
+ * Writes that make the selected bit fall, by resetting DIV or changing TAC,
+ * count as an edge as on hardware. The reload happens at once rather than
+ * a machine cycle after the overflow.
+ */
+class Timer {
+public:
+  //! The divider after the boot ROM, DIV 0xAB.
+  constexpr static uint16_t bootDivider = 0xABCC;
+
+  //! Timer must be attached to a machine.
+  Timer() = delete;
+
+  /**
+   * \param state The machine state, which must outlive the timer.
+   * \param scheduler The scheduler to register overflows with, which must
+   * outlive the timer.
+   */
+  Timer(MachineState &state, Scheduler &scheduler);
+
+  //! Reset the divider to its value after the boot ROM, with TIMA stopped.
+  void reset();
+
+  //! Catch TIMA up to the machine clock, registering the next overflow.
+  //! Handles the Scheduler::Timer event.
+  void sync();
+
+  //! Register the next overflow, e.g. after restoring a snapshot.
+  void schedule();
+
+  /**
+   * \brief Read a timer register.
+   * \param reg The register offset from 0xFF00, 0x04-0x07.
+   */
+  uint8_t read(uint8_t reg);
+
+  /**
+   * \brief Write a timer register.
+   * \param reg The register offset from 0xFF00, 0x04-0x07.
+   * \param value The value written.
+   */
+  void write(uint8_t reg, uint8_t value);
+
+private:
+  //! The divider as of TIMA's last catch up.
+  uint16_t divider() const;
+
+  //! log2 of the clocks per TIMA increment for \p tac.
+  static unsigned periodShift(uint8_t tac);
+
+  //! Whether \p tac enables TIMA and selects a bit that is set in \p div.
+  static bool clockLine(uint8_t tac, uint16_t div);
+
+  //! Count \p edges TIMA increments, reloading and interrupting on overflow.
+  void count(uint64_t edges);
+
+private:
+  //! The machine state.
+  MachineState &state;
+
+  //! The scheduler overflows are registered with.
+  Scheduler &scheduler;
+};
+
+#endif // GB_TIMER_H
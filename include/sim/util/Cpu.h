@@ -0,0 +1,54 @@
+#ifndef GB_CPU_H
+#define GB_CPU_H
+
+//! Whether the x86 SIMD code paths are compiled in.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GB_X86_SIMD 1
+#else
+#define GB_X86_SIMD 0
+#endif
+
+//! Namespace holding host CPU feature queries, for runtime dispatch.
+namespace cpuutil {
+
+//! Make the feature queries safe to use from static initializers, which may
+//! run before the compiler runtime has probed the CPU.
+inline void init() {
+#if GB_X86_SIMD
+  __builtin_cpu_init();
+#endif
+}
+
+//! Whether the host supports SSE2.
+inline bool hasSse2() {
+#if GB_X86_SIMD
+  init();
+  return __builtin_cpu_supports("sse2");
+#else
+  return false;
+#endif
+}
+
+//! Whether the host supports AVX2.
+inline bool hasAvx2() {
+#if GB_X86_SIMD
+  init();
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+//! Whether the host supports BMI2.
+inline bool hasBmi2() {
+#if GB_X86_SIMD
+  init();
+  return __builtin_cpu_supports("bmi2");
+#else
+  return false;
+#endif
+}
+
+} // End namespace cpuutil.
+
+#endif // GB_CPU_H
@@ -0,0 +1,81 @@
+#ifndef GB_HASH_H
+#define GB_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//! Namespace holding hashing utilities.
+namespace hashutil {
+
+//! Multiplicative constants (from xxHash64).
+constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+
+//! Rotate \p x left by \p r bits.
+inline uint64_t rotl(uint64_t x, unsigned r) {
+  return (x << r) | (x >> (64u - r));
+}
+
+//! Final avalanche mix.
+inline uint64_t mix(uint64_t h) {
+  h ^= h >> 33u;
+  h *= prime2;
+  h ^= h >> 29u;
+  h *= prime3;
+  h ^= h >> 32u;
+  return h;
+}
+
+//! Fold one 64-bit word into a hash lane.
+inline uint64_t round(uint64_t lane, uint64_t word) {
+  lane += word * prime2;
+  lane = rotl(lane, 31);
+  return lane * prime1;
+}
+
+/**
+ * \brief A fast, non-cryptographic 64-bit hash.
+ *
+ * Consumes four independent 64-bit lanes at a time so that large inputs (ROM
+ * images, frames) hash at memory speed. Not suitable for adversarial input.
+ *
+ * \param data The bytes to hash.
+ * \param size The number of bytes.
+ * \param seed An optional seed.
+ * \return The 64-bit hash.
+ */
+inline uint64_t hash64(const void *data, std::size_t size, uint64_t seed = 0) {
+  const auto *p = static_cast<const uint8_t *>(data);
+  const uint8_t *end = p + size;
+
+  uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+  while (end - p >= 32) {
+    for (uint64_t &lane : lanes) {
+      uint64_t word;
+      std::memcpy(&word, p, sizeof word);
+      lane = round(lane, word);
+      p += 8;
+    }
+  }
+
+  uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+  h += size;
+
+  while (end - p >= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof word);
+    h ^= round(0, word);
+    h = rotl(h, 27) * prime1 + prime3;
+    p += 8;
+  }
+  while (p < end)
+    h = rotl(h ^ (*p++ * prime3), 11) * prime1;
+
+  return mix(h);
+}
+
+} // End namespace hashutil.
+
+#endif // GB_HASH_H
@@ -0,0 +1,127 @@
+#ifndef GB_SPSCRING_H
+#define GB_SPSCRING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * \brief A bounded, lock-free, single producer single consumer queue.
+ *
+ * One thread may push and one other thread may pop, concurrently and without
+ * locks. Each side caches the other side's index so that it only touches the
+ * shared cache line when the ring looks full (or empty).
+ *
+ * \tparam T The element type, which must be trivially copyable.
+ * \tparam Capacity The number of elements, a power of two.
+ */
+template <typename T, std::size_t Capacity>
+class SpscRing {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "SpscRing capacity must be a power of two.");
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SpscRing elements must be trivially copyable.");
+
+public:
+  SpscRing() : head(0), tailCache(0), tail(0), headCache(0) { }
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  /**
+   * \brief Append an element. Producer only.
+   * \return false if the ring was full and nothing was pushed.
+   */
+  bool push(const T &item) {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (h - tailCache == Capacity) {
+      tailCache = tail.load(std::memory_order_acquire);
+      if (h - tailCache == Capacity)
+        return false;
+    }
+    slots[h & (Capacity - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * \brief Remove the oldest element. Consumer only.
+   * \return false if the ring was empty and \p item is unchanged.
+   */
+  bool pop(T &item) {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t == headCache) {
+      headCache = head.load(std::memory_order_acquire);
+      if (t == headCache)
+        return false;
+    }
+    item = slots[t & (Capacity - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * \brief Append as many of \p count elements as fit. Producer only.
+   * \return The number of elements pushed.
+   */
+  std::size_t push(const T *items, std::size_t count) {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (Capacity - (h - tailCache) < count)
+      tailCache = tail.load(std::memory_order_acquire);
+    count = std::min(count, Capacity - (h - tailCache));
+
+    // At most two runs, split where the slots wrap.
+    std::size_t first = std::min(count, Capacity - (h & (Capacity - 1)));
+    std::copy(items, items + first, slots + (h & (Capacity - 1)));
+    std::copy(items + first, items + count, slots);
+    head.store(h + count, std::memory_order_release);
+    return count;
+  }
+
+  /**
+   * \brief Remove up to \p count of the oldest elements. Consumer only.
+   * \return The number of elements popped.
+   */
+  std::size_t pop(T *items, std::size_t count) {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (headCache - t < count)
+      headCache = head.load(std::memory_order_acquire);
+    count = std::min(count, headCache - t);
+
+    std::size_t first = std::min(count, Capacity - (t & (Capacity - 1)));
+    std::copy(slots + (t & (Capacity - 1)), slots + (t & (Capacity - 1)) + first, items);
+    std::copy(slots, slots + (count - first), items + first);
+    tail.store(t + count, std::memory_order_release);
+    return count;
+  }
+
+  //! The number of elements held. Exact for neither side while the other
+  //! is busy, but never more than the capacity.
+  std::size_t size() const {
+    std::size_t t = tail.load(std::memory_order_acquire);
+    return std::min(head.load(std::memory_order_acquire) - t, Capacity);
+  }
+
+  //! Whether the ring is empty. Exact for the consumer, a hint for the producer.
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  //! The number of elements the ring holds.
+  constexpr static std::size_t capacity() { return Capacity; }
+
+private:
+  //! The next slot to write, and the producer's copy of tail.
+  alignas(64) std::atomic<std::size_t> head;
+  std::size_t tailCache;
+
+  //! The next slot to read, and the consumer's copy of head.
+  alignas(64) std::atomic<std::size_t> tail;
+  std::size_t headCache;
+
+  //! The elements.
+  alignas(64) T slots[Capacity];
+};
+
+#endif // GB_SPSCRING_H
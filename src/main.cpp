@@ -1,7 +1,30 @@
 #include "sim/Simulator.h"
+#include "sim/rom/RomIndex.h"
 
 #include "loguru.hpp"
 
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * \brief Index a ROM library.
+ *
+ * Usage: gb --index <index file> <ROM or directory>...
+ */
+int buildIndex(int argc, char **argv) {
+  if (argc < 4)
+    ABORT_F("Usage: %s --index <index file> <ROM or directory>...", argv[0]);
+
+  std::vector<std::string> paths(argv + 3, argv + argc);
+  RomIndex index = RomIndex::build(paths);
+  return index.save(argv[2]) ? 0 : 1;
+}
+
+} // End anonymous namespace.
+
 int main(int argc, char **argv) {
   loguru::Options opts {"-v", "main", true};
   loguru::init(argc, argv, opts);
@@ -9,8 +32,31 @@ int main(int argc, char **argv) {
   if (argc < 2)
     ABORT_F("Not enough arguments.");
 
-  LOG_F(INFO, "Creating simulator.");
-  Simulator sim(argv[1]);
+  if (std::strcmp(argv[1], "--index") == 0) {
+    int status = buildIndex(argc, argv);
+    loguru::shutdown();
+    return status;
+  }
+
+  // gb [--headless] <ROM>
+  SimulatorOptions options;
+  int romArg = 1;
+  if (std::strcmp(argv[1], "--headless") == 0) {
+    options.headless = true;
+    options.silent = true;
+    ++romArg;
+  }
+  if (romArg >= argc)
+    ABORT_F("Usage: %s [--headless] <ROM>", argv[0]);
+
+  LOG_F(INFO, "Creating %ssimulator.", options.headless ? "headless " : "");
+  Simulator sim(argv[romArg], options);
+
+  std::vector<uint8_t> framebuffer;
+  if (!options.headless) {
+    framebuffer.resize(lcd::width * lcd::height);
+    sim.setFramebuffer(framebuffer.data());
+  }
 
   sim.run();
 
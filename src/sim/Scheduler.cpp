@@ -0,0 +1,78 @@
+#include "sim/Scheduler.h"
+
+Scheduler::Scheduler() : deadlines(), heap(), count(0) {
+  for (uint8_t &s : slot)
+    s = Events;
+}
+
+void Scheduler::schedule(Event event, uint64_t cycle) {
+  unsigned i = slot[event];
+  if (i >= count) {
+    i = count++;
+    place(i, event);
+    deadlines[event] = cycle;
+    siftUp(i);
+    return;
+  }
+
+  bool earlier = cycle < deadlines[event];
+  deadlines[event] = cycle;
+  if (earlier)
+    siftUp(i);
+  else
+    siftDown(i);
+}
+
+void Scheduler::cancel(Event event) {
+  unsigned i = slot[event];
+  if (i >= count)
+    return;
+
+  slot[event] = Events;
+  if (i == --count)
+    return;
+
+  // Fill the hole with the last entry, which may belong above or below it.
+  Event moved = heap[count];
+  place(i, moved);
+  siftUp(i);
+  if (slot[moved] == i)
+    siftDown(i);
+}
+
+bool Scheduler::pop(uint64_t now, Event &event) {
+  if (count == 0 || deadlines[heap[0]] > now)
+    return false;
+
+  event = heap[0];
+  cancel(event);
+  return true;
+}
+
+void Scheduler::siftUp(unsigned i) {
+  Event event = heap[i];
+  while (i > 0) {
+    unsigned parent = (i - 1) / 2;
+    if (!before(event, heap[parent]))
+      break;
+    place(i, heap[parent]);
+    i = parent;
+  }
+  place(i, event);
+}
+
+void Scheduler::siftDown(unsigned i) {
+  Event event = heap[i];
+  for (;;) {
+    unsigned child = 2 * i + 1;
+    if (child >= count)
+      break;
+    if (child + 1 < count && before(heap[child + 1], heap[child]))
+      ++child;
+    if (!before(heap[child], event))
+      break;
+    place(i, heap[child]);
+    i = child;
+  }
+  place(i, event);
+}
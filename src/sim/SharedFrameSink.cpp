@@ -0,0 +1,196 @@
+#include "sim/SharedFrameSink.h"
+
+#include "sim/ppu/Renderer.h"
+
+#include "loguru.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+//! Identifies a shared frame segment.
+constexpr char sinkMagic[4] = {'G', 'B', 'F', 'S'};
+
+//! Bumped whenever the segment layout changes.
+constexpr uint32_t sinkVersion = 2;
+
+//! Round \p n up to a cache line.
+constexpr std::size_t lineAlign(std::size_t n) {
+  return (n + 63u) & ~std::size_t(63u);
+}
+
+} // End anonymous namespace.
+
+std::unique_ptr<SharedFrameSink> SharedFrameSink::create(const char *name, PixelFormat format,
+                                                         bool withState) {
+  if (name == nullptr || name[0] != '/') {
+    LOG_F(ERROR, "Shared memory name must start with '/'.");
+    return nullptr;
+  }
+
+  std::size_t pitch = lcd::width * pixelfmt::bytesPerPixel(format);
+  std::size_t pixelsOffset = lineAlign(sizeof(SharedFrameSlot));
+  std::size_t stateOffset = pixelsOffset + lineAlign(pitch * lcd::height);
+  std::size_t slotSize = stateOffset + (withState ? lineAlign(sizeof(MachineState)) : 0);
+  std::size_t size = lineAlign(sizeof(SharedFrameHeader)) + 2 * slotSize;
+
+  // Start from a fresh segment so no reader sees a stale layout.
+  ::shm_unlink(name);
+  int fd = ::shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    LOG_F(ERROR, "Shared memory %s failed to open: %s.", name, std::strerror(errno));
+    return nullptr;
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    LOG_F(ERROR, "Shared memory %s failed to resize: %s.", name, std::strerror(errno));
+    ::close(fd);
+    ::shm_unlink(name);
+    return nullptr;
+  }
+  void *map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    LOG_F(ERROR, "Shared memory %s failed to map: %s.", name, std::strerror(errno));
+    ::shm_unlink(name);
+    return nullptr;
+  }
+
+  // The segment is zero filled, so the counters start at 0.
+  auto *header = static_cast<SharedFrameHeader *>(map);
+  std::memcpy(header->magic, sinkMagic, sizeof sinkMagic);
+  header->version = sinkVersion;
+  header->width = lcd::width;
+  header->height = lcd::height;
+  header->pitch = static_cast<uint32_t>(pitch);
+  header->format = format;
+  header->hasState = withState;
+  header->stateSize = sizeof(MachineState);
+  header->slotOffset[0] = lineAlign(sizeof(SharedFrameHeader));
+  header->slotOffset[1] = header->slotOffset[0] + slotSize;
+  header->pixelsOffset = pixelsOffset;
+  header->stateOffset = stateOffset;
+
+  LOG_F(INFO, "Publishing frames to shared memory %s (%zu bytes).", name, size);
+  return std::unique_ptr<SharedFrameSink>(new SharedFrameSink(name, map, size));
+}
+
+SharedFrameSink::SharedFrameSink(std::string name, void *map, std::size_t size)
+    : name(std::move(name)), map(map), size(size), header(static_cast<SharedFrameHeader *>(map)),
+      writing(0) {
+  beginSlot();
+}
+
+SharedFrameSink::~SharedFrameSink() {
+  ::munmap(map, size);
+  ::shm_unlink(name.c_str());
+}
+
+SharedFrameSlot &SharedFrameSink::slot(unsigned index) const {
+  return *reinterpret_cast<SharedFrameSlot *>(static_cast<uint8_t *>(map) + header->slotOffset[index]);
+}
+
+Framebuffer SharedFrameSink::framebuffer() const {
+  auto *pixels = reinterpret_cast<uint8_t *>(&slot(writing)) + header->pixelsOffset;
+  return Framebuffer {pixels, header->format, header->pitch};
+}
+
+void SharedFrameSink::beginSlot() {
+  std::atomic<uint64_t> &sequence = slot(writing).sequence;
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SharedFrameSink::publish(uint64_t frame, uint64_t hash, const MachineState &state) {
+  SharedFrameSlot &s = slot(writing);
+  s.frame = frame;
+  s.cycles = state.cycles;
+  s.hash = hash;
+  if (header->hasState)
+    std::memcpy(reinterpret_cast<uint8_t *>(&s) + header->stateOffset, &state, sizeof state);
+
+  s.sequence.store(s.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  header->latest.store(header->latest.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_release);
+
+  writing ^= 1u;
+  beginSlot();
+}
+
+std::unique_ptr<SharedFrameReader> SharedFrameReader::open(const char *name) {
+  int fd = ::shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG_F(WARNING, "Shared memory %s failed to open: %s.", name, std::strerror(errno));
+    return nullptr;
+  }
+
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SharedFrameHeader)) {
+    LOG_F(WARNING, "Shared memory %s is truncated.", name);
+    ::close(fd);
+    return nullptr;
+  }
+
+  auto size = static_cast<std::size_t>(st.st_size);
+  void *map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    LOG_F(WARNING, "Shared memory %s failed to map.", name);
+    return nullptr;
+  }
+
+  const auto *header = static_cast<const SharedFrameHeader *>(map);
+  if (std::memcmp(header->magic, sinkMagic, sizeof sinkMagic) != 0 ||
+      header->version != sinkVersion) {
+    LOG_F(WARNING, "Shared memory %s is invalid or from another version.", name);
+    ::munmap(map, size);
+    return nullptr;
+  }
+
+  return std::unique_ptr<SharedFrameReader>(new SharedFrameReader(map, size));
+}
+
+SharedFrameReader::SharedFrameReader(const void *map, std::size_t size)
+    : map(map), size(size), header(static_cast<const SharedFrameHeader *>(map)) { }
+
+SharedFrameReader::~SharedFrameReader() {
+  ::munmap(const_cast<void *>(map), size);
+}
+
+bool SharedFrameReader::acquire(View &view) const {
+  // A slot found mid-write means the writer lapped us; the other slot is then
+  // the newest, so a retry or two always settles.
+  for (int attempt = 0; attempt < 4; ++attempt) {
+    uint64_t latest = header->latest.load(std::memory_order_acquire);
+    if (latest == 0)
+      return false;
+
+    unsigned index = static_cast<unsigned>((latest - 1) & 1u);
+    const auto *base = static_cast<const uint8_t *>(map) + header->slotOffset[index];
+    const auto *slot = reinterpret_cast<const SharedFrameSlot *>(base);
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence & 1u)
+      continue;
+
+    view.frame = slot->frame;
+    view.cycles = slot->cycles;
+    view.hash = slot->hash;
+    view.pixels = base + header->pixelsOffset;
+    view.state = header->hasState ? base + header->stateOffset : nullptr;
+    view.slot = index;
+    view.sequence = sequence;
+    return valid(view);
+  }
+  return false;
+}
+
+bool SharedFrameReader::valid(const View &view) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const auto *slot = reinterpret_cast<const SharedFrameSlot *>(
+      static_cast<const uint8_t *>(map) + header->slotOffset[view.slot]);
+  return slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
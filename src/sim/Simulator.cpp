@@ -1,6 +1,7 @@
 #include "sim/Simulator.h"
 
 #include "sim/mem/MBC0.h"
+#include "sim/mem/MBC3.h"
 
 #include "loguru.hpp"
 
@@ -13,14 +14,49 @@ using namespace regdefaults;
 
 namespace {
 
+//! Take a state from \p pool, or the heap if there is no pool or it's empty.
+std::unique_ptr<MachineState, StatePool::Deleter> acquireState(StatePool *pool) {
+  MachineState *pooled = pool != nullptr ? pool->acquire() : nullptr;
+  LOG_IF_F(WARNING, pool != nullptr && pooled == nullptr,
+           "State pool exhausted, allocating state on the heap.");
+  if (pooled != nullptr)
+    return std::unique_ptr<MachineState, StatePool::Deleter>(pooled, StatePool::Deleter {pool});
+  return std::unique_ptr<MachineState, StatePool::Deleter>(new MachineState());
+}
+
+//! Where the PPU composes pixels for a configuration.
+PPU::Compose composeMode(const SimulatorOptions &options) {
+  if (options.headless)
+    return PPU::Compose::None;
+  if (options.renderThread)
+    return PPU::Compose::Thread;
+  return options.deferredRender ? PPU::Compose::Deferred : PPU::Compose::Inline;
+}
 
 } // End anonymous namespace.
 
-// Init values to 0 so as to avoid undefined behaviour in calling member
-// functions (i.e. reset).
-Simulator::Simulator(const char *romLoc) : PC(0), SP(0), regs{0}, mem(nullptr) {
+// Value-initialise the state so as to avoid undefined behaviour in calling
+// member functions (i.e. reset).
+Simulator::Simulator(const char *romLoc, const SimulatorOptions &options)
+    : state(acquireState(nullptr)), ppu(*state, scheduler, composeMode(options)),
+      apu(*state, scheduler, options.silent), timer(*state, scheduler), mem(nullptr) {
   load(romLoc);
   reset();
+  loadBattery();
+}
+
+Simulator::Simulator(std::shared_ptr<const RomImage> rom, StatePool *pool,
+                     const SimulatorOptions &options)
+    : state(acquireState(pool)), ppu(*state, scheduler, composeMode(options)),
+      apu(*state, scheduler, options.silent), timer(*state, scheduler), mem(nullptr) {
+  load(std::move(rom));
+  reset();
+  loadBattery();
+}
+
+Simulator::~Simulator() {
+  recordAudio(nullptr);
+  saveBattery();
 }
 
 void Simulator::reset() {
@@ -28,51 +64,148 @@ void Simulator::reset() {
 
   // Reset registers.
   DLOG_F(1, "Resetting physical registers.");
-  PC = 0;
-  SP = 0xFFFE;
-  std::memcpy(regs, physRegs, sizeof physRegs);
+  state->PC = 0;
+  state->SP = 0xFFFE;
+  std::memcpy(state->regs, physRegs, sizeof physRegs);
   DLOG_F(1, "Done resetting physical registers.");
 
+  // Reset the APU and timer before memory, so they see the register
+  // defaults.
+  apu.reset();
+  timer.reset();
+
   // Reset memory.
   assert(mem != nullptr && "Memory controller was null.");
   mem->reset();
 
+  // Reset peripherals, after the I/O registers they read.
+  ppu.reset();
+
   LOG_F(INFO, "Finished resetting simulator.");
 }
 
 void Simulator::load(const char *romLoc) {
-  DLOG_S(INFO) << "Opening ROM at " << romLoc;
-  std::ifstream rom(romLoc, std::ifstream::in | std::ifstream::binary);
+  std::shared_ptr<const RomImage> image = RomImage::load(romLoc);
+  if (image == nullptr)
+    ABORT_F("ROM failed to load.");
 
-  if (!rom.is_open())
-    ABORT_F("ROM failed to open.");
+  load(std::move(image));
+}
 
-  mem = std::make_unique<MBC0>(rom);
+void Simulator::load(std::shared_ptr<const RomImage> image) {
+  rom = std::move(image);
+  const CartridgeHeader &header = rom->header();
+
+  LOG_F(INFO, "Cartridge \"%s\": type 0x%02X, ROM %u bytes, RAM %u bytes.", header.title,
+        header.type, header.romSize, header.ramSize);
+  LOG_IF_F(WARNING, !header.has(CartridgeHeader::SizeOk),
+           "True and calculated ROM size mismatch! True: %zu, calculated: %u",
+           rom->size(), header.romSize);
+  LOG_IF_F(WARNING, !header.has(CartridgeHeader::HeaderChecksumOk), "Header checksum mismatch.");
+  DLOG_IF_F(WARNING, !header.has(CartridgeHeader::GlobalChecksumOk), "Global checksum mismatch.");
+  DLOG_IF_F(WARNING, !header.has(CartridgeHeader::LogoOk), "Logo mismatch.");
+
+  // Pick the memory controller from the cartridge type.
+  if (header.mapper == Mapper::MBC3) {
+    mem = std::make_unique<MBC3>(*rom, *state);
+  }
+  else {
+    LOG_IF_F(WARNING, header.mapper != Mapper::None,
+             "Unsupported cartridge type 0x%02X, using MBC0.", header.type);
+    mem = std::make_unique<MBC0>(*rom, *state);
+  }
+  // The PPU tracks OAM for sprite selection, and VRAM too when composing.
+  mem->attachPpu(&ppu);
+  mem->attachApu(&apu);
+  mem->attachTimer(&timer);
+
+  // The save sits next to the ROM with a .sav extension.
+  savePath = rom->path();
+  std::size_t dot = savePath.find_last_of('.');
+  std::size_t slash = savePath.find_last_of('/');
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    savePath.erase(dot);
+  savePath += ".sav";
+}
 
-#ifndef NDEBUG
-  rom.seekg(0, std::ifstream::end);
-  std::streampos trueSize = rom.tellg();
-  rom.seekg(0, std::ifstream::beg);
-  DLOG_S(1) << "ROM true size: " << trueSize;
-#endif
+void Simulator::loadBattery() {
+  if (!mem->hasBattery())
+    return;
 
-  rom.seekg(0x148, std::ifstream::beg);
+  std::ifstream save(savePath, std::ifstream::in | std::ifstream::binary);
+  if (!save.is_open()) {
+    DLOG_S(INFO) << "No battery save at " << savePath;
+    return;
+  }
 
-  uint8_t byte;
-  rom >> byte;
-  DLOG_IF_F(1, rom.bad(), "ROM read failure!");
+  DLOG_S(INFO) << "Loading battery save from " << savePath;
+  mem->loadBattery(save);
+}
 
-  uint32_t size = 1u << (15u + byte);
-  DLOG_F(1, "ROM calculated size: %u", size);
+void Simulator::saveBattery() const {
+  if (mem == nullptr || !mem->hasBattery())
+    return;
 
-#ifndef NDEBUG
-  DLOG_IF_F(WARNING, trueSize != size,
-            "True and calculated ROM size mismatch! True: %u, calculated: %u",
-            static_cast<unsigned>(trueSize), size);
-#endif
+  DLOG_S(INFO) << "Writing battery save to " << savePath;
+  std::ofstream save(savePath, std::ofstream::out | std::ofstream::binary);
+  if (!save.is_open()) {
+    LOG_F(ERROR, "Battery save failed to open.");
+    return;
+  }
 
+  mem->saveBattery(save);
 }
 
 void Simulator::run() {
 }
 
+void Simulator::dispatch() {
+  // Each handler registers its next event.
+  Scheduler::Event event;
+  while (scheduler.pop(state->cycles, event)) {
+    switch (event) {
+    case Scheduler::Ppu:
+      ppu.sync();
+      break;
+    case Scheduler::Apu:
+      apu.advance();
+      break;
+    case Scheduler::Timer:
+      timer.sync();
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+bool Simulator::publishFrames(const char *name, PixelFormat format, bool withState) {
+  if (ppu.headless()) {
+    LOG_F(ERROR, "Headless simulator: no frames to publish.");
+    return false;
+  }
+
+  // The PPU lets go of the old segment before it goes away.
+  ppu.attachSink(nullptr);
+  sink = SharedFrameSink::create(name, format, withState);
+  ppu.attachSink(sink.get());
+  return sink != nullptr;
+}
+
+bool Simulator::recordAudio(const char *prefix) {
+  // Finish any recording first, up to now.
+  apu.attachRecorder(nullptr);
+  recorder.reset();
+  if (prefix == nullptr)
+    return true;
+
+  if (apu.silent()) {
+    LOG_F(ERROR, "Silent simulator: no sound to record.");
+    return false;
+  }
+
+  recorder = AudioRecorder::create(prefix, APU::sampleRate);
+  apu.attachRecorder(recorder.get());
+  return recorder != nullptr;
+}
+
@@ -0,0 +1,107 @@
+#include "sim/StatePool.h"
+
+#include "loguru.hpp"
+
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+
+namespace {
+
+//! Map \p size bytes of anonymous memory, nullptr on failure.
+uint8_t *mapAnonymous(std::size_t size, int extraFlags) {
+  void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+  return p == MAP_FAILED ? nullptr : static_cast<uint8_t *>(p);
+}
+
+} // End anonymous namespace.
+
+void StatePool::Deleter::operator()(MachineState *s) const {
+  if (pool != nullptr)
+    pool->release(s);
+  else
+    delete s;
+}
+
+StatePool::StatePool(std::size_t capacity, Backing preferred)
+    : base(nullptr), mapSize(0), slots(capacity), mapBacking(Backing::Normal) {
+  // Round up to whole huge pages so the last one isn't split.
+  std::size_t bytes = capacity * slotSize;
+  mapSize = (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+  if (mapSize == 0)
+    mapSize = hugePageSize;
+
+#ifdef MAP_HUGETLB
+  if (preferred >= Backing::Explicit) {
+    base = mapAnonymous(mapSize, MAP_HUGETLB);
+    if (base != nullptr)
+      mapBacking = Backing::Explicit;
+    else
+      DLOG_F(1, "Explicit huge pages unavailable, trying transparent huge pages.");
+  }
+#endif
+
+#ifdef MADV_HUGEPAGE
+  if (base == nullptr && preferred >= Backing::Transparent) {
+    // Over-map by a huge page and trim so the pool starts on a 2 MiB boundary,
+    // otherwise the kernel can't back the edges with huge pages.
+    uint8_t *raw = mapAnonymous(mapSize + hugePageSize, 0);
+    if (raw != nullptr) {
+      auto addr = reinterpret_cast<std::uintptr_t>(raw);
+      std::uintptr_t aligned = (addr + hugePageSize - 1) & ~(hugePageSize - 1);
+      std::size_t head = aligned - addr;
+      if (head != 0)
+        ::munmap(raw, head);
+      ::munmap(reinterpret_cast<uint8_t *>(aligned) + mapSize, hugePageSize - head);
+      base = reinterpret_cast<uint8_t *>(aligned);
+
+      if (::madvise(base, mapSize, MADV_HUGEPAGE) == 0)
+        mapBacking = Backing::Transparent;
+      else
+        DLOG_F(1, "Transparent huge pages unavailable, using normal pages.");
+    }
+  }
+#endif
+
+  if (base == nullptr)
+    base = mapAnonymous(mapSize, 0);
+  if (base == nullptr)
+    ABORT_F("Failed to map state pool of %zu bytes.", mapSize);
+
+  LOG_F(INFO, "State pool: %zu slots in %zu bytes, backing %u.", slots, mapSize,
+        static_cast<unsigned>(mapBacking));
+
+  freeSlots.reserve(slots);
+  for (std::size_t i = slots; i > 0; --i)
+    freeSlots.push_back(i - 1);
+}
+
+StatePool::~StatePool() {
+  DLOG_IF_F(WARNING, freeSlots.size() != slots, "State pool destroyed with %zu states in use.",
+            slots - freeSlots.size());
+  ::munmap(base, mapSize);
+}
+
+MachineState *StatePool::acquire() {
+  std::size_t slot;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (freeSlots.empty())
+      return nullptr;
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  }
+
+  return new (base + slot * slotSize) MachineState();
+}
+
+void StatePool::release(MachineState *s) {
+  auto *p = reinterpret_cast<uint8_t *>(s);
+  CHECK_F(p >= base && p < base + slots * slotSize && (p - base) % slotSize == 0,
+          "State released to the wrong pool.");
+
+  std::lock_guard<std::mutex> guard(lock);
+  freeSlots.push_back(static_cast<std::size_t>(p - base) / slotSize);
+}
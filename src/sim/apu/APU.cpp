@@ -0,0 +1,546 @@
+#include "sim/apu/APU.h"
+
+#include "sim/MachineState.h"
+#include "sim/apu/AudioRecorder.h"
+#include "sim/apu/AudioRing.h"
+
+#include "loguru.hpp"
+
+#include <algorithm>
+
+namespace {
+
+//! Bits read back as 1 from NR10 to NR51, as write-only or unused.
+constexpr uint8_t readMasks[snd::NR52 - snd::NR10] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,  // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,  // NR20-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,  // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,  // NR40-NR44
+    0x00, 0x00                     // NR50-NR51
+};
+
+//! The square wave duty cycles, one bit per step.
+constexpr uint8_t dutyWaves[4] = {0x80, 0x81, 0xE1, 0x7E};
+
+//! The noise channel's clock divisors, by NR43 bits 0-2.
+constexpr uint32_t noiseDivisors[8] = {8, 16, 32, 48, 64, 80, 96, 112};
+
+//! The amplitude of one level step at full master volume. Four channels at
+//! level 15 and volume 8 just fit in 16 bits.
+constexpr int32_t levelUnit = 64;
+
+//! Stereo samples per block passed to the resampler.
+constexpr std::size_t nativeBlock = 1024;
+
+//! The amplitude of one level step in a channel's own recording.
+constexpr int32_t stemUnit = 2048;
+
+//! The most samples one batch completes.
+constexpr std::size_t batchSamples = APU::batchClocks / BlipBuffer::clocksPerSample + 1;
+
+//! The channel a register from NR10 to NR44 belongs to.
+inline unsigned channelOf(uint8_t reg) {
+  return (reg - snd::NR10) / 5u;
+}
+
+} // End anonymous namespace.
+
+APU::APU(MachineState &state, Scheduler &scheduler, bool silent)
+    : state(state), scheduler(scheduler), synthesize(!silent), left(silent ? 0 : sampleRate / 4),
+      right(silent ? 0 : sampleRate / 4), leftAmp(), rightAmp(), hostRate(0), stream(nullptr),
+      recorder(nullptr), stemAmp() { }
+
+void APU::reset() {
+  DLOG_F(1, "Resetting APU.");
+  ApuState &a = state.apu;
+  a = ApuState();
+  a.time = state.cycles;
+  a.sequencerTimer = sequencerPeriod;
+  a.lfsr = 0x7FFF;
+  state.IO[snd::NR52] = snd::Power;
+  stateRestored();
+}
+
+void APU::advance() {
+  // Due a batch after the last catch up, which registered it.
+  if (!synthesize)
+    return;
+  sync();
+  if (stream != nullptr)
+    flush();
+}
+
+void APU::sync() {
+  ApuState &a = state.apu;
+  while (a.time < state.cycles) {
+    auto clocks = static_cast<uint32_t>(std::min<uint64_t>(state.cycles - a.time, batchClocks));
+    if (!synthesize) {
+      run(clocks);
+      a.time += clocks;
+      continue;
+    }
+    if (!left.fits(clocks)) {
+      DLOG_F(2, "Audio not read, dropping %zu samples.", left.available());
+      left.discard(left.available());
+      right.discard(right.available());
+    }
+    run(clocks);
+    left.endFrame(clocks);
+    right.endFrame(clocks);
+    for (BlipBuffer &stem : stems)
+      stem.endFrame(clocks);
+    a.time += clocks;
+    if (recorder != nullptr)
+      record();
+  }
+  if (synthesize)
+    scheduler.schedule(Scheduler::Apu, a.time + batchClocks);
+}
+
+uint8_t APU::read(uint8_t reg) {
+  if (reg >= snd::WaveRam)
+    return state.IO[reg];
+  if (reg > snd::NR52)
+    return 0xFF;
+
+  if (reg == snd::NR52) {
+    // The channel bits change on their own, as lengths run out.
+    sync();
+    uint8_t status = static_cast<uint8_t>((state.IO[snd::NR52] & snd::Power) | 0x70u);
+    for (unsigned ch = 0; ch < snd::channels; ++ch)
+      status |= state.apu.channels[ch].on ? 1u << ch : 0u;
+    return status;
+  }
+  return state.IO[reg] | readMasks[reg - snd::NR10];
+}
+
+void APU::write(uint8_t reg, uint8_t value) {
+  sync();
+  uint8_t *io = state.IO.data();
+
+  if (reg >= snd::WaveRam) {
+    io[reg] = value;
+    output(2, 0);
+    return;
+  }
+
+  if (reg == snd::NR52) {
+    bool wasOn = io[snd::NR52] & snd::Power;
+    if (wasOn && !(value & snd::Power)) {
+      powerOff();
+    }
+    else if (!wasOn && (value & snd::Power)) {
+      state.apu.sequencerStep = 0;
+      state.apu.sequencerTimer = sequencerPeriod;
+    }
+    io[snd::NR52] = value & snd::Power;
+    return;
+  }
+
+  // The other registers are read only while the APU is off.
+  if (!(io[snd::NR52] & snd::Power) || reg > snd::NR52)
+    return;
+  io[reg] = value;
+
+  switch (reg) {
+  case snd::NR11:
+  case snd::NR21:
+  case snd::NR41:
+    state.apu.channels[channelOf(reg)].length = static_cast<uint16_t>(64u - (value & 63u));
+    break;
+  case snd::NR31:
+    state.apu.channels[2].length = static_cast<uint16_t>(256u - value);
+    break;
+  case snd::NR12:
+  case snd::NR22:
+  case snd::NR30:
+  case snd::NR42:
+    if (!dacOn(channelOf(reg)))
+      stop(channelOf(reg), 0);
+    break;
+  case snd::NR14:
+  case snd::NR24:
+  case snd::NR34:
+  case snd::NR44:
+    if (value & 0x80u)
+      trigger(channelOf(reg));
+    break;
+  case snd::NR50:
+  case snd::NR51:
+    for (unsigned ch = 0; ch < snd::channels; ++ch)
+      output(ch, 0);
+    return;
+  default:
+    break;
+  }
+  output(channelOf(reg), 0);
+}
+
+void APU::stateRestored() {
+  left.clear();
+  right.clear();
+  for (BlipBuffer &stem : stems)
+    stem.clearInStep(left);
+  std::fill(stemAmp, stemAmp + snd::channels, 0);
+  if (resampler != nullptr)
+    resampler->clear();
+  std::fill(leftAmp, leftAmp + snd::channels, 0);
+  std::fill(rightAmp, rightAmp + snd::channels, 0);
+  if (synthesize)
+    scheduler.schedule(Scheduler::Apu, state.apu.time + batchClocks);
+}
+
+void APU::setOutputRate(unsigned rate) {
+  hostRate = rate == sampleRate ? 0 : rate;
+  if (stream != nullptr) {
+    LOG_F(WARNING, "Output rate follows the audio stream until streaming stops.");
+    return;
+  }
+  useHostRate();
+}
+
+void APU::useHostRate() {
+  if (hostRate == 0) {
+    resampler.reset();
+    native.clear();
+    return;
+  }
+  LOG_F(INFO, "Resampling audio from %u Hz to %u Hz.", sampleRate, hostRate);
+  resampler = std::make_unique<Resampler>(sampleRate, hostRate);
+  native.resize(2 * nativeBlock);
+}
+
+std::size_t APU::samplesAvailable() const {
+  return resampler != nullptr ? resampler->outputFor(left.available()) : left.available();
+}
+
+void APU::attachStream(AudioRing *ring) {
+  bool streaming = stream != nullptr;
+  stream = ring;
+  if (ring == nullptr) {
+    if (streaming) {
+      LOG_F(INFO, "Audio stream detached, back to %u Hz.", hostRate != 0 ? hostRate : sampleRate);
+      useHostRate();
+    }
+    return;
+  }
+
+  LOG_IF_F(WARNING, !synthesize, "Silent APU has no sound to stream.");
+  // Rate control needs a resampler, even at the native rate.
+  LOG_F(INFO, "Streaming audio at %u Hz.", ring->rate());
+  resampler = std::make_unique<Resampler>(sampleRate, ring->rate());
+  native.resize(2 * nativeBlock);
+}
+
+void APU::attachRecorder(AudioRecorder *rec) {
+  sync();
+  recorder = rec;
+  stems.clear();
+  if (rec == nullptr)
+    return;
+  if (!synthesize) {
+    LOG_F(WARNING, "Silent APU has no sound to record.");
+    recorder = nullptr;
+    return;
+  }
+
+  // Start every file from now, with the channels at their current levels.
+  left.skipTap();
+  right.skipTap();
+  stems.assign(snd::channels, BlipBuffer(batchSamples));
+  for (unsigned ch = 0; ch < snd::channels; ++ch) {
+    stems[ch].clearInStep(left);
+    stemAmp[ch] = level(ch) * stemUnit;
+    stems[ch].addDelta(0, stemAmp[ch]);
+  }
+}
+
+std::size_t APU::readSamples(int16_t *out, std::size_t frames) {
+  sync();
+  return drain(out, frames);
+}
+
+void APU::flush() {
+  resampler->setRateAdjust(stream->rateAdjust());
+  int16_t block[2 * nativeBlock];
+  while (left.available() > 0)
+    stream->write(block, drain(block, nativeBlock));
+}
+
+void APU::record() {
+  int16_t mix[2 * batchSamples];
+  int16_t channels[snd::channels][batchSamples];
+  const int16_t *channelPtrs[snd::channels];
+
+  DCHECK_F(left.untapped() <= batchSamples, "Recording fell behind.");
+  std::size_t count = left.tap(mix, 2);
+  right.tap(mix + 1, 2);
+  for (unsigned ch = 0; ch < snd::channels; ++ch) {
+    stems[ch].read(channels[ch], count);
+    channelPtrs[ch] = channels[ch];
+  }
+  recorder->write(mix, channelPtrs, count);
+}
+
+std::size_t APU::drain(int16_t *out, std::size_t frames) {
+  if (resampler == nullptr) {
+    std::size_t count = left.read(out, frames, 2);
+    right.read(out + 1, count, 2);
+    return count;
+  }
+
+  // Only take the input that fits the caller's buffer once resampled.
+  std::size_t input = std::min(resampler->inputFor(frames), left.available());
+  std::size_t written = 0;
+  while (input > 0) {
+    std::size_t count = left.read(native.data(), std::min<std::size_t>(input, nativeBlock), 2);
+    right.read(native.data() + 1, count, 2);
+    written += resampler->push(native.data(), count, out + 2 * written);
+    input -= count;
+  }
+  return written;
+}
+
+void APU::run(uint32_t clocks) {
+  // Powered off, every channel is stopped and the sequencer is held.
+  ApuState &a = state.apu;
+  if (!(state.IO[snd::NR52] & snd::Power))
+    return;
+
+  // Between sequencer steps the channels only depend on their own timers.
+  uint32_t time = 0;
+  while (time < clocks) {
+    uint32_t end = std::min(clocks, time + a.sequencerTimer);
+    for (unsigned ch = 0; synthesize && ch < snd::channels; ++ch)
+      runChannel(ch, time, end);
+    a.sequencerTimer -= end - time;
+    time = end;
+    if (a.sequencerTimer == 0) {
+      a.sequencerTimer = sequencerPeriod;
+      stepSequencer(time);
+    }
+  }
+}
+
+void APU::runChannel(unsigned ch, uint32_t from, uint32_t to) {
+  ApuChannel &c = state.apu.channels[ch];
+  uint32_t stepClocks = period(ch);
+  if (!c.on || stepClocks == 0)
+    return;
+
+  uint32_t time = from + c.timer;
+  while (time < to) {
+    step(ch);
+    output(ch, time);
+    time += stepClocks;
+  }
+  c.timer = time - to;
+}
+
+void APU::step(unsigned ch) {
+  ApuState &a = state.apu;
+  ApuChannel &c = a.channels[ch];
+  switch (ch) {
+  case 0:
+  case 1:
+    c.position = (c.position + 1u) & 7u;
+    break;
+  case 2:
+    c.position = (c.position + 1u) & 31u;
+    break;
+  default: {
+    unsigned bit = (a.lfsr ^ (a.lfsr >> 1u)) & 1u;
+    a.lfsr = static_cast<uint16_t>((a.lfsr >> 1u) | (bit << 14u));
+    // The short mode also feeds bit 6, for a 7 bit sequence.
+    if (state.IO[snd::NR43] & 0x08u)
+      a.lfsr = static_cast<uint16_t>((a.lfsr & ~0x40u) | (bit << 6u));
+    break;
+  }
+  }
+}
+
+void APU::stepSequencer(uint32_t time) {
+  ApuState &a = state.apu;
+  uint8_t *io = state.IO.data();
+  unsigned s = a.sequencerStep;
+  a.sequencerStep = (s + 1u) & 7u;
+
+  // Length counters on even steps.
+  if ((s & 1u) == 0) {
+    for (unsigned ch = 0; ch < snd::channels; ++ch) {
+      ApuChannel &c = a.channels[ch];
+      if ((io[snd::channelBase[ch] + 4] & 0x40u) && c.length != 0 && --c.length == 0)
+        stop(ch, time);
+    }
+  }
+
+  if (s == 2 || s == 6)
+    stepSweep(time);
+
+  // Envelopes on the last step. Only the output hears them.
+  if (s == 7 && synthesize) {
+    for (unsigned ch : {0u, 1u, 3u}) {
+      ApuChannel &c = a.channels[ch];
+      uint8_t envelope = io[snd::channelBase[ch] + 2];
+      unsigned stepTicks = envelope & 7u;
+      if (!c.on || stepTicks == 0 || --c.envelopeTimer != 0)
+        continue;
+      c.envelopeTimer = static_cast<uint8_t>(stepTicks);
+      if ((envelope & 0x08u) && c.volume < 15)
+        ++c.volume;
+      else if (!(envelope & 0x08u) && c.volume > 0)
+        --c.volume;
+      output(ch, time);
+    }
+  }
+}
+
+void APU::stepSweep(uint32_t time) {
+  ApuState &a = state.apu;
+  uint8_t *io = state.IO.data();
+  if (--a.sweepTimer != 0)
+    return;
+
+  unsigned stepTicks = (io[snd::NR10] >> 4u) & 7u;
+  a.sweepTimer = static_cast<uint8_t>(stepTicks != 0 ? stepTicks : 8u);
+  if (!a.sweepOn || stepTicks == 0)
+    return;
+
+  unsigned next = sweepNext(time);
+  if (next <= 2047 && (io[snd::NR10] & 7u)) {
+    a.sweepFrequency = static_cast<uint16_t>(next);
+    io[snd::NR13] = static_cast<uint8_t>(next);
+    io[snd::NR14] = static_cast<uint8_t>((io[snd::NR14] & ~7u) | (next >> 8u));
+    // The new frequency is checked for overflow straight away too.
+    sweepNext(time);
+  }
+}
+
+unsigned APU::sweepNext(uint32_t time) {
+  ApuState &a = state.apu;
+  uint8_t nr10 = state.IO[snd::NR10];
+  unsigned delta = a.sweepFrequency >> (nr10 & 7u);
+  unsigned next = (nr10 & 0x08u) ? a.sweepFrequency - delta : a.sweepFrequency + delta;
+  if (next > 2047)
+    stop(0, time);
+  return next;
+}
+
+void APU::trigger(unsigned ch) {
+  ApuState &a = state.apu;
+  ApuChannel &c = a.channels[ch];
+  const uint8_t *io = state.IO.data();
+  uint8_t envelope = io[snd::channelBase[ch] + 2];
+
+  if (c.length == 0)
+    c.length = ch == 2 ? 256 : 64;
+  c.timer = period(ch);
+  c.volume = envelope >> 4u;
+  c.envelopeTimer = static_cast<uint8_t>((envelope & 7u) != 0 ? envelope & 7u : 8u);
+  c.on = dacOn(ch);
+
+  if (ch == 0) {
+    uint8_t nr10 = io[snd::NR10];
+    unsigned stepTicks = (nr10 >> 4u) & 7u;
+    a.sweepFrequency = static_cast<uint16_t>(frequency(0));
+    a.sweepTimer = static_cast<uint8_t>(stepTicks != 0 ? stepTicks : 8u);
+    a.sweepOn = stepTicks != 0 || (nr10 & 7u) != 0;
+    if (nr10 & 7u)
+      sweepNext(0);
+  }
+  else if (ch == 2) {
+    c.position = 0;
+  }
+  else if (ch == 3) {
+    a.lfsr = 0x7FFF;
+  }
+}
+
+void APU::stop(unsigned ch, uint32_t time) {
+  state.apu.channels[ch].on = 0;
+  output(ch, time);
+}
+
+void APU::powerOff() {
+  DLOG_F(1, "APU powered off.");
+  std::fill(state.IO.begin() + snd::NR10, state.IO.begin() + snd::NR52, 0);
+  for (unsigned ch = 0; ch < snd::channels; ++ch)
+    stop(ch, 0);
+}
+
+unsigned APU::frequency(unsigned ch) const {
+  uint8_t base = snd::channelBase[ch];
+  return state.IO[base + 3] | ((state.IO[base + 4] & 7u) << 8u);
+}
+
+uint32_t APU::period(unsigned ch) const {
+  switch (ch) {
+  case 0:
+  case 1:
+    return (2048u - frequency(ch)) * 4u;
+  case 2:
+    return (2048u - frequency(ch)) * 2u;
+  default: {
+    // Shifts of 14 and 15 stop the noise clock.
+    uint8_t nr43 = state.IO[snd::NR43];
+    unsigned shift = nr43 >> 4u;
+    return shift < 14 ? noiseDivisors[nr43 & 7u] << shift : 0;
+  }
+  }
+}
+
+bool APU::dacOn(unsigned ch) const {
+  if (ch == 2)
+    return state.IO[snd::NR30] & 0x80u;
+  return state.IO[snd::channelBase[ch] + 2] & 0xF8u;
+}
+
+int APU::level(unsigned ch) const {
+  const ApuState &a = state.apu;
+  const ApuChannel &c = a.channels[ch];
+  if (!c.on)
+    return 0;
+
+  switch (ch) {
+  case 0:
+  case 1: {
+    unsigned duty = state.IO[snd::channelBase[ch] + 1] >> 6u;
+    return ((dutyWaves[duty] >> c.position) & 1u) ? c.volume : 0;
+  }
+  case 2: {
+    // Two samples per byte, high nibble first, scaled by the NR32 level.
+    uint8_t pair = state.IO[snd::WaveRam + c.position / 2u];
+    unsigned sample = (c.position & 1u) ? pair & 15u : pair >> 4u;
+    unsigned code = (state.IO[snd::NR32] >> 5u) & 3u;
+    return code != 0 ? static_cast<int>(sample >> (code - 1u)) : 0;
+  }
+  default:
+    return (a.lfsr & 1u) ? 0 : c.volume;
+  }
+}
+
+void APU::output(unsigned ch, uint32_t time) {
+  if (!synthesize)
+    return;
+
+  const uint8_t *io = state.IO.data();
+  int channelLevel = level(ch);
+  int32_t amp = channelLevel * levelUnit;
+
+  if (!stems.empty() && channelLevel * stemUnit != stemAmp[ch]) {
+    stems[ch].addDelta(time, channelLevel * stemUnit - stemAmp[ch]);
+    stemAmp[ch] = channelLevel * stemUnit;
+  }
+
+  int32_t l = (io[snd::NR51] >> (ch + 4u)) & 1u ? amp * (((io[snd::NR50] >> 4u) & 7) + 1) : 0;
+  if (l != leftAmp[ch]) {
+    left.addDelta(time, l - leftAmp[ch]);
+    leftAmp[ch] = l;
+  }
+
+  int32_t r = (io[snd::NR51] >> ch) & 1u ? amp * ((io[snd::NR50] & 7) + 1) : 0;
+  if (r != rightAmp[ch]) {
+    right.addDelta(time, r - rightAmp[ch]);
+    rightAmp[ch] = r;
+  }
+}
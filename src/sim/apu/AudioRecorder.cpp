@@ -0,0 +1,217 @@
+#include "sim/apu/AudioRecorder.h"
+
+#include "loguru.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+//! The file name suffixes, in file order.
+constexpr const char *suffixes[AudioRecorder::files] = {"-mix.wav", "-ch1.wav", "-ch2.wav",
+                                                        "-ch3.wav", "-ch4.wav"};
+
+//! The size of a canonical PCM WAV header.
+constexpr std::size_t headerSize = 44;
+
+//! Buffers are aligned for the page cache and any future direct I/O.
+constexpr std::size_t bufferAlign = 4096;
+
+//! Store \p value little endian.
+void putLe(uint8_t *out, uint32_t value, unsigned bytes) {
+  for (unsigned i = 0; i < bytes; ++i)
+    out[i] = static_cast<uint8_t>(value >> (8u * i));
+}
+
+//! Write all of \p size bytes at \p offset, or the end if negative.
+bool writeAll(int fd, const void *bytes, std::size_t size, off_t offset = -1) {
+  const auto *p = static_cast<const uint8_t *>(bytes);
+  while (size > 0) {
+    ssize_t n = offset < 0 ? ::write(fd, p, size) : ::pwrite(fd, p, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= static_cast<std::size_t>(n);
+    if (offset >= 0)
+      offset += n;
+  }
+  return true;
+}
+
+} // End anonymous namespace.
+
+std::unique_ptr<AudioRecorder> AudioRecorder::create(const std::string &prefix, unsigned rate) {
+  std::vector<int> fds;
+  std::vector<std::string> paths;
+  for (unsigned i = 0; i < files; ++i) {
+    paths.push_back(prefix + suffixes[i]);
+    int fd = ::open(paths.back().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    // 16 bit PCM, with the sizes left for the destructor.
+    unsigned channels = i == 0 ? 2 : 1;
+    uint8_t header[headerSize] = {};
+    std::memcpy(header, "RIFF", 4);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    putLe(header + 16, 16, 4);
+    putLe(header + 20, 1, 2);
+    putLe(header + 22, channels, 2);
+    putLe(header + 24, rate, 4);
+    putLe(header + 28, rate * channels * 2, 4);
+    putLe(header + 32, channels * 2, 2);
+    putLe(header + 34, 16, 2);
+    std::memcpy(header + 36, "data", 4);
+
+    if (fd < 0 || !writeAll(fd, header, sizeof header)) {
+      LOG_F(ERROR, "Audio recording %s failed to open: %s.", paths.back().c_str(),
+            std::strerror(errno));
+      if (fd >= 0)
+        fds.push_back(fd);
+      for (int open : fds)
+        ::close(open);
+      return nullptr;
+    }
+    fds.push_back(fd);
+  }
+
+  LOG_F(INFO, "Recording audio to %s-*.wav at %u Hz.", prefix.c_str(), rate);
+  return std::unique_ptr<AudioRecorder>(new AudioRecorder(std::move(fds), std::move(paths)));
+}
+
+AudioRecorder::AudioRecorder(std::vector<int> fds, std::vector<std::string> paths)
+    : fds(std::move(fds)), paths(std::move(paths)),
+      full(std::make_unique<SpscRing<Buffer *, maxBuffers>>()),
+      empty(std::make_unique<SpscRing<Buffer *, maxBuffers>>()), written() {
+  if (sem_init(&ready, 0, 0) != 0)
+    ABORT_F("Audio writer semaphore failed to initialise: %s.", std::strerror(errno));
+  for (unsigned i = 0; i < files; ++i)
+    current[i] = acquire(i);
+  thread = std::thread(&AudioRecorder::work, this);
+}
+
+AudioRecorder::~AudioRecorder() {
+  for (unsigned i = 0; i < files; ++i)
+    send(i);
+  sem_post(&ready);
+  thread.join();
+  sem_destroy(&ready);
+
+  // Fill in the RIFF and data sizes, capped at what the format can hold.
+  for (unsigned i = 0; i < files; ++i) {
+    auto data = static_cast<uint32_t>(std::min<uint64_t>(written[i], 0xFFFFFFFFu - 36u));
+    uint8_t size[4];
+    putLe(size, data + 36u, 4);
+    bool ok = writeAll(fds[i], size, sizeof size, 4);
+    putLe(size, data, 4);
+    ok = ok && writeAll(fds[i], size, sizeof size, 40);
+    LOG_IF_F(ERROR, !ok, "Audio recording %s failed to finish.", paths[i].c_str());
+    ::close(fds[i]);
+  }
+
+  for (const std::unique_ptr<Buffer> &buffer : buffers)
+    std::free(buffer->data);
+}
+
+void AudioRecorder::write(const int16_t *mix, const int16_t *const *channels, std::size_t frames) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  // WAV samples are little endian.
+  auto appendSamples = [this](unsigned file, const int16_t *samples, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      uint16_t sample = __builtin_bswap16(static_cast<uint16_t>(samples[i]));
+      append(file, &sample, sizeof sample);
+    }
+  };
+#else
+  auto appendSamples = [this](unsigned file, const int16_t *samples, std::size_t count) {
+    append(file, samples, count * sizeof(int16_t));
+  };
+#endif
+  appendSamples(0, mix, 2 * frames);
+  for (unsigned i = 1; i < files; ++i)
+    appendSamples(i, channels[i - 1], frames);
+}
+
+void AudioRecorder::append(unsigned file, const void *bytes, std::size_t size) {
+  const auto *p = static_cast<const uint8_t *>(bytes);
+  while (size > 0) {
+    Buffer *buffer = current[file];
+    std::size_t count = std::min(size, bufferSize - buffer->used);
+    std::memcpy(buffer->data + buffer->used, p, count);
+    buffer->used += count;
+    p += count;
+    size -= count;
+    if (buffer->used == bufferSize)
+      submit(file);
+  }
+}
+
+void AudioRecorder::submit(unsigned file) {
+  if (current[file]->used == 0)
+    return;
+  send(file);
+  current[file] = acquire(file);
+}
+
+void AudioRecorder::send(unsigned file) {
+  if (current[file]->used == 0)
+    return;
+
+  // The ring holds every buffer there is, so it only looks full while the
+  // writer catches up. The post never blocks.
+  while (!full->push(current[file]))
+    std::this_thread::yield();
+  sem_post(&ready);
+}
+
+AudioRecorder::Buffer *AudioRecorder::acquire(unsigned file) {
+  Buffer *buffer = nullptr;
+  if (!empty->pop(buffer)) {
+    if (buffers.size() < maxBuffers) {
+      buffers.push_back(std::make_unique<Buffer>());
+      buffer = buffers.back().get();
+      buffer->data = static_cast<uint8_t *>(std::aligned_alloc(bufferAlign, bufferSize));
+      if (buffer->data == nullptr)
+        ABORT_F("Audio recording buffer failed to allocate.");
+    }
+    else {
+      // The writer is a whole 64 MiB behind; wait rather than drop samples.
+      DLOG_F(2, "Audio recording buffers exhausted, waiting.");
+      while (!empty->pop(buffer))
+        std::this_thread::yield();
+    }
+  }
+  buffer->used = 0;
+  buffer->file = file;
+  return buffer;
+}
+
+void AudioRecorder::work() {
+  loguru::set_thread_name("audio writer");
+  DLOG_F(1, "Audio writer started.");
+
+  // Each post is a buffer, except the last, which comes after every buffer
+  // and finds the ring empty.
+  Buffer *buffer = nullptr;
+  for (;;) {
+    while (sem_wait(&ready) != 0 && errno == EINTR) { }
+    if (!full->pop(buffer))
+      break;
+    store(buffer);
+  }
+
+  DLOG_F(1, "Audio writer stopped.");
+}
+
+void AudioRecorder::store(Buffer *buffer) {
+  if (writeAll(fds[buffer->file], buffer->data, buffer->used))
+    written[buffer->file] += buffer->used;
+  else
+    LOG_F(ERROR, "Audio recording %s failed to write: %s.", paths[buffer->file].c_str(),
+          std::strerror(errno));
+  empty->push(buffer);
+}
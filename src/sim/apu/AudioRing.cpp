@@ -0,0 +1,32 @@
+#include "sim/apu/AudioRing.h"
+
+#include <algorithm>
+
+AudioRing::AudioRing(unsigned rate)
+    : sampleRate(rate), ring(std::make_unique<SpscRing<int16_t, 2 * capacity>>()), dropped(0),
+      starved(0) { }
+
+std::size_t AudioRing::write(const int16_t *samples, std::size_t frames) {
+  std::size_t written = ring->push(samples, 2 * frames) / 2;
+  if (written < frames)
+    dropped.fetch_add(frames - written, std::memory_order_relaxed);
+  return written;
+}
+
+double AudioRing::rateAdjust() const {
+  // Linear in the fill: 1 at half full, reaching the limits a quarter
+  // either side, so a drift close to the limit still leaves room for a
+  // batch.
+  double fullness = static_cast<double>(fill()) / capacity;
+  double adjust = 1.0 + maxAdjust * 4.0 * (0.5 - fullness);
+  return std::min(std::max(adjust, 1.0 - maxAdjust), 1.0 + maxAdjust);
+}
+
+std::size_t AudioRing::read(int16_t *out, std::size_t frames) {
+  std::size_t count = ring->pop(out, 2 * frames) / 2;
+  if (count < frames) {
+    std::fill(out + 2 * count, out + 2 * frames, 0);
+    starved.fetch_add(frames - count, std::memory_order_relaxed);
+  }
+  return count;
+}
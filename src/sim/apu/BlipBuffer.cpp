@@ -0,0 +1,133 @@
+#include "sim/apu/BlipBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+//! Fraction bits of kernel taps and accumulated impulses.
+constexpr unsigned kernelBits = 15;
+
+//! Reading leaks 1/2^bassShift of the level per sample, a high-pass at about
+//! 20 Hz that removes the DC offset of the channels.
+constexpr unsigned bassShift = 9;
+
+//! The band-limited impulse for each phase, each summing to 1 << kernelBits.
+struct Kernel {
+  int32_t taps[BlipBuffer::phases][BlipBuffer::kernelWidth];
+
+  Kernel() {
+    constexpr double pi = 3.14159265358979323846;
+    constexpr double cutoff = 0.45;
+    constexpr double half = BlipBuffer::kernelWidth / 2.0;
+
+    for (unsigned phase = 0; phase < BlipBuffer::phases; ++phase) {
+      // A Blackman windowed sinc, centred between taps 7 and 8 plus the phase.
+      double shape[BlipBuffer::kernelWidth];
+      double sum = 0;
+      for (unsigned i = 0; i < BlipBuffer::kernelWidth; ++i) {
+        double x = i + 0.5 - half - static_cast<double>(phase) / BlipBuffer::phases;
+        double sinc = x == 0 ? 1.0 : std::sin(2 * pi * cutoff * x) / (2 * pi * cutoff * x);
+        double window = 0.42 + 0.5 * std::cos(pi * x / half) + 0.08 * std::cos(2 * pi * x / half);
+        shape[i] = sinc * window;
+        sum += shape[i];
+      }
+
+      // Round, then put the rounding error on the centre tap so a step
+      // always settles on exactly its delta.
+      int32_t total = 0;
+      for (unsigned i = 0; i < BlipBuffer::kernelWidth; ++i) {
+        taps[phase][i] = static_cast<int32_t>(std::lround(shape[i] / sum * (1 << kernelBits)));
+        total += taps[phase][i];
+      }
+      taps[phase][BlipBuffer::kernelWidth / 2] += (1 << kernelBits) - total;
+    }
+  }
+};
+
+const Kernel kernel;
+
+} // End anonymous namespace.
+
+BlipBuffer::BlipBuffer(std::size_t capacity)
+    : accum(capacity + kernelWidth, 0), ready(0), fraction(0), level(0), tapped(0), tapLevel(0) { }
+
+void BlipBuffer::addDelta(uint32_t time, int32_t delta) {
+  uint32_t clocks = fraction + time;
+  int32_t *out = accum.data() + ready + clocks / clocksPerSample;
+  const int32_t *taps = kernel.taps[(clocks % clocksPerSample) * phases / clocksPerSample];
+  for (unsigned i = 0; i < kernelWidth; ++i)
+    out[i] += delta * taps[i];
+}
+
+void BlipBuffer::endFrame(uint32_t clocks) {
+  uint32_t total = fraction + clocks;
+  ready += total / clocksPerSample;
+  fraction = total % clocksPerSample;
+}
+
+std::size_t BlipBuffer::read(int16_t *out, std::size_t count, std::size_t stride) {
+  count = std::min(count, ready);
+  for (std::size_t i = 0; i < count; ++i)
+    out[i * stride] = integrate(level, accum[i]);
+  remove(count);
+  return count;
+}
+
+std::size_t BlipBuffer::tap(int16_t *out, std::size_t stride) {
+  std::size_t count = ready - tapped;
+  for (std::size_t i = 0; i < count; ++i)
+    out[i * stride] = integrate(tapLevel, accum[tapped + i]);
+  tapped = ready;
+  return count;
+}
+
+void BlipBuffer::skipTap() {
+  for (; tapped < ready; ++tapped)
+    integrate(tapLevel, accum[tapped]);
+}
+
+void BlipBuffer::clearInStep(const BlipBuffer &other) {
+  clear();
+  fraction = other.fraction;
+}
+
+int16_t BlipBuffer::integrate(int32_t &sum, int32_t impulses) {
+  sum += impulses;
+  int32_t sample = sum >> kernelBits;
+  sum -= sample << (kernelBits - bassShift);
+  sample = std::max<int32_t>(sample, std::numeric_limits<int16_t>::min());
+  sample = std::min<int32_t>(sample, std::numeric_limits<int16_t>::max());
+  return static_cast<int16_t>(sample);
+}
+
+void BlipBuffer::discard(std::size_t count) {
+  count = std::min(count, ready);
+  // Keep integrating, so what follows starts from the right level.
+  for (std::size_t i = 0; i < count; ++i)
+    integrate(level, accum[i]);
+  remove(count);
+}
+
+void BlipBuffer::clear() {
+  std::fill(accum.begin(), accum.end(), 0);
+  ready = 0;
+  fraction = 0;
+  level = 0;
+  tapped = 0;
+  tapLevel = 0;
+}
+
+void BlipBuffer::remove(std::size_t count) {
+  // Deltas reach at most a kernel past the end of the last frame.
+  std::size_t live = ready + (fraction + clocksPerSample - 1) / clocksPerSample + kernelWidth;
+  live = std::min(live, accum.size());
+  std::copy(accum.begin() + count, accum.begin() + live, accum.begin());
+  std::fill(accum.begin() + (live - count), accum.begin() + live, 0);
+  ready -= count;
+  // Removed samples the tap has not seen are lost to it; it picks up after.
+  if (tapped < count)
+    tapLevel = level;
+  tapped = tapped > count ? tapped - count : 0;
+}
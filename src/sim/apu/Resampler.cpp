@@ -0,0 +1,266 @@
+#include "sim/apu/Resampler.h"
+
+#include "sim/util/Cpu.h"
+
+#include "loguru.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if GB_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+//! Fraction bits of the filter taps.
+constexpr unsigned kernelBits = 15;
+
+//! Fraction bits of positions in the input.
+constexpr unsigned positionBits = 32;
+
+//! The filter phase for a position.
+inline unsigned phaseOf(uint64_t position) {
+  return static_cast<unsigned>((position & 0xFFFFFFFFu) * Resampler::phases >> positionBits);
+}
+
+//! Round a dot product to a sample.
+inline int16_t toSample(int32_t sum) {
+  int32_t sample = (sum + (1 << (kernelBits - 1))) >> kernelBits;
+  sample = std::max<int32_t>(sample, std::numeric_limits<int16_t>::min());
+  sample = std::min<int32_t>(sample, std::numeric_limits<int16_t>::max());
+  return static_cast<int16_t>(sample);
+}
+
+// Each filter produces a stereo output per position. The taps sum to
+// 1 << kernelBits and a sample is at most 1 << 15, so every dot product fits
+// in 32 bits.
+
+std::size_t filterScalar(const int16_t *left, const int16_t *right, const int16_t *kernel,
+                         uint64_t &position, uint64_t last, uint64_t step, int16_t *out) {
+  std::size_t count = 0;
+  for (; position <= last; position += step, ++count) {
+    const int16_t *x = left + (position >> positionBits);
+    const int16_t *y = right + (position >> positionBits);
+    const int16_t *h = kernel + phaseOf(position) * Resampler::taps;
+    int32_t l = 0, r = 0;
+    for (unsigned i = 0; i < Resampler::taps; ++i) {
+      l += x[i] * h[i];
+      r += y[i] * h[i];
+    }
+    out[2 * count] = toSample(l);
+    out[2 * count + 1] = toSample(r);
+  }
+  return count;
+}
+
+#if GB_X86_SIMD
+
+static_assert(Resampler::taps % 16 == 0, "SIMD filters work on 16 taps at a time.");
+
+//! Sum the lanes of the left and right dot products, round and saturate,
+//! and store the stereo sample.
+inline void storeSample(__m128i l, __m128i r, int16_t *out) {
+  __m128i sum = _mm_add_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+  sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+  sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (kernelBits - 1))), kernelBits);
+  auto pair = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packs_epi32(sum, sum)));
+  std::memcpy(out, &pair, sizeof pair);
+}
+
+std::size_t filterSse2(const int16_t *left, const int16_t *right, const int16_t *kernel,
+                       uint64_t &position, uint64_t last, uint64_t step, int16_t *out) {
+  auto load = [](const int16_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); };
+  std::size_t count = 0;
+  for (; position <= last; position += step, ++count) {
+    const int16_t *x = left + (position >> positionBits);
+    const int16_t *y = right + (position >> positionBits);
+    const int16_t *h = kernel + phaseOf(position) * Resampler::taps;
+    __m128i l = _mm_setzero_si128(), r = _mm_setzero_si128();
+    for (unsigned i = 0; i < Resampler::taps; i += 8) {
+      __m128i k = load(h + i);
+      l = _mm_add_epi32(l, _mm_madd_epi16(load(x + i), k));
+      r = _mm_add_epi32(r, _mm_madd_epi16(load(y + i), k));
+    }
+    storeSample(l, r, out + 2 * count);
+  }
+  return count;
+}
+
+__attribute__((target("avx2"))) std::size_t filterAvx2(const int16_t *left, const int16_t *right,
+                                                      const int16_t *kernel, uint64_t &position,
+                                                      uint64_t last, uint64_t step, int16_t *out) {
+  std::size_t count = 0;
+  for (; position <= last; position += step, ++count) {
+    const int16_t *x = left + (position >> positionBits);
+    const int16_t *y = right + (position >> positionBits);
+    const int16_t *h = kernel + phaseOf(position) * Resampler::taps;
+    __m256i l = _mm256_setzero_si256(), r = _mm256_setzero_si256();
+    for (unsigned i = 0; i < Resampler::taps; i += 16) {
+      __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(h + i));
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + i));
+      __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(y + i));
+      l = _mm256_add_epi32(l, _mm256_madd_epi16(a, k));
+      r = _mm256_add_epi32(r, _mm256_madd_epi16(b, k));
+    }
+    storeSample(_mm_add_epi32(_mm256_castsi256_si128(l), _mm256_extracti128_si256(l, 1)),
+                _mm_add_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1)),
+                out + 2 * count);
+  }
+  return count;
+}
+
+#endif // GB_X86_SIMD
+
+//! The entry point for an implementation.
+std::size_t (*entry(Resampler::Impl impl))(const int16_t *, const int16_t *, const int16_t *,
+                                           uint64_t &, uint64_t, uint64_t, int16_t *) {
+  switch (impl) {
+#if GB_X86_SIMD
+  case Resampler::Impl::SSE2:
+    return filterSse2;
+  case Resampler::Impl::AVX2:
+    return filterAvx2;
+#endif
+  default:
+    return filterScalar;
+  }
+}
+
+} // End anonymous namespace.
+
+Resampler::Resampler(unsigned inputRate, unsigned outputRate)
+    : Resampler(inputRate, outputRate, best()) { }
+
+Resampler::Resampler(unsigned inputRate, unsigned outputRate, Impl impl)
+    : filter(entry(supported(impl) ? impl : Impl::Scalar)), inRate(inputRate),
+      outRate(outputRate), baseStep((static_cast<uint64_t>(inputRate) << positionBits) / outputRate),
+      step(baseStep),
+      kernel(phases * taps), history(2 * (blockFrames + taps), 0), held(0), position(0) {
+  LOG_IF_F(ERROR, !supported(impl), "Resampler implementation %s not supported, using scalar.",
+           name(impl));
+
+  constexpr double pi = 3.14159265358979323846;
+  constexpr double half = taps / 2.0;
+
+  // Pass up to the lower Nyquist frequency, less half the Blackman window's
+  // transition band, so little above it survives to alias.
+  double nyquist = 0.5 * std::min(1.0, static_cast<double>(outputRate) / inputRate);
+  double cutoff = nyquist - 2.75 / taps;
+
+  for (unsigned phase = 0; phase < phases; ++phase) {
+    // Centred between taps 15 and 16, plus the phase.
+    int16_t *h = &kernel[phase * taps];
+    double shape[taps];
+    double sum = 0;
+    for (unsigned i = 0; i < taps; ++i) {
+      double x = i + 1.0 - half - static_cast<double>(phase) / phases;
+      double sinc = x == 0 ? 1.0 : std::sin(2 * pi * cutoff * x) / (2 * pi * cutoff * x);
+      double window = 0.42 + 0.5 * std::cos(pi * x / half) + 0.08 * std::cos(2 * pi * x / half);
+      shape[i] = sinc * window;
+      sum += shape[i];
+    }
+
+    // Round, then put the rounding error on the centre tap so DC passes
+    // exactly.
+    int32_t total = 0;
+    for (unsigned i = 0; i < taps; ++i) {
+      h[i] = static_cast<int16_t>(std::lround(shape[i] / sum * (1 << kernelBits)));
+      total += h[i];
+    }
+    h[taps / 2 - 1] = static_cast<int16_t>(h[taps / 2 - 1] + (1 << kernelBits) - total);
+  }
+}
+
+/**
+ * \brief The fastest implementation the host supports.
+ *
+ * Measured with gb-bench-resampler, both SIMD filters beat the scalar one,
+ * which the compiler does not vectorise well for 32 taps.
+ */
+Resampler::Impl Resampler::best() {
+  if (supported(Impl::AVX2))
+    return Impl::AVX2;
+  if (supported(Impl::SSE2))
+    return Impl::SSE2;
+  return Impl::Scalar;
+}
+
+const char *Resampler::name(Impl impl) {
+  switch (impl) {
+  case Impl::SSE2:
+    return "SSE2";
+  case Impl::AVX2:
+    return "AVX2";
+  default:
+    return "scalar";
+  }
+}
+
+bool Resampler::supported(Impl impl) {
+  switch (impl) {
+  case Impl::SSE2:
+    return cpuutil::hasSse2();
+  case Impl::AVX2:
+    return cpuutil::hasAvx2();
+  default:
+    return true;
+  }
+}
+
+void Resampler::setRateAdjust(double adjust) {
+  step = static_cast<uint64_t>(std::llround(static_cast<double>(baseStep) / adjust));
+}
+
+std::size_t Resampler::push(const int16_t *in, std::size_t frames, int16_t *out) {
+  std::size_t written = 0;
+  int16_t *left = history.data();
+  int16_t *right = left + blockFrames + taps;
+
+  while (frames > 0) {
+    // Deinterleave a block after the history, so each tap run is contiguous.
+    std::size_t count = std::min<std::size_t>(frames, blockFrames + taps - held);
+    for (std::size_t i = 0; i < count; ++i) {
+      left[held + i] = in[2 * i];
+      right[held + i] = in[2 * i + 1];
+    }
+    held += count;
+    in += 2 * count;
+    frames -= count;
+
+    if (held >= taps) {
+      uint64_t last = static_cast<uint64_t>(held - taps) << positionBits;
+      written += filter(left, right, kernel.data(), position, last, step, out + 2 * written);
+    }
+
+    // Keep only what later outputs reach back to.
+    std::size_t used = std::min<std::size_t>(position >> positionBits, held);
+    std::memmove(left, left + used, (held - used) * sizeof(int16_t));
+    std::memmove(right, right + used, (held - used) * sizeof(int16_t));
+    held -= used;
+    position -= static_cast<uint64_t>(used) << positionBits;
+  }
+  return written;
+}
+
+std::size_t Resampler::outputFor(std::size_t frames) const {
+  std::size_t total = held + frames;
+  if (total < taps)
+    return 0;
+
+  uint64_t last = static_cast<uint64_t>(total - taps) << positionBits;
+  return position > last ? 0 : static_cast<std::size_t>((last - position) / step + 1);
+}
+
+std::size_t Resampler::inputFor(std::size_t frames) const {
+  // One more output would need the input up to its last tap.
+  std::size_t next = static_cast<std::size_t>((position + frames * step) >> positionBits) + taps;
+  return next > held ? next - held - 1 : 0;
+}
+
+void Resampler::clear() {
+  held = 0;
+  position = 0;
+}
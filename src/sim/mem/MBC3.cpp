@@ -0,0 +1,142 @@
+#include "sim/mem/MBC3.h"
+
+#include "loguru.hpp"
+
+#include <istream>
+#include <ostream>
+
+MBC3::MBC3(const RomImage &rom, MachineState &state)
+    : MemoryController(rom, state), rtc(state.rtc, state.cycles), ramBanks(0),
+      timer(false), battery(false) {
+  LOG_F(INFO, "Initialising MBC3.");
+
+  const CartridgeHeader &header = rom.header();
+  timer = header.has(CartridgeHeader::Timer);
+  battery = header.has(CartridgeHeader::Battery);
+  DLOG_F(1, "MBC3 type 0x%02X: timer %d, battery %d.", header.type, timer, battery);
+
+  // Partial banks (2 KiB carts) still occupy a whole bank of state.
+  std::size_t banks = (header.ramSize + kilo8 - 1) / kilo8;
+  if (banks > state.ERAM.size() / kilo8) {
+    LOG_F(WARNING, "MBC3 RAM size %u too large: truncated.", header.ramSize);
+    banks = state.ERAM.size() / kilo8;
+  }
+  ramBanks = static_cast<uint8_t>(banks);
+  DLOG_F(1, "Mapping %zu ROM banks and %u ERAM banks.", rom.bankCount(), ramBanks);
+
+  rtc.reset();
+}
+
+uint8_t MBC3::read8(uint16_t address) const {
+  DLOG_F(2, "Read8: mem[0x%04X]", address);
+  // ROM0.
+  if (address < 0x4000u) {
+    return rom.bank(0)[address];
+  }
+  // ROM1, switchable.
+  else if (address < 0x8000u) {
+    return rom.bank(state.mapper.romBank)[address - 0x4000u];
+  }
+  // ERAM or RTC register.
+  else if (address >= 0xA000u && address < 0xC000u) {
+    uint8_t ramBank = state.mapper.ramBank;
+    if (!state.mapper.ramEnable) {
+      LOG_F(WARNING, "Read from disabled ERAM: ignored.");
+      return 0xFF;
+    }
+    if (ramBank < ramBanks)
+      return state.ERAM[ramBank * kilo8 + address - 0xA000u];
+    if (timer && ramBank >= RealTimeClock::Seconds)
+      return rtc.read(ramBank);
+    LOG_F(WARNING, "Read from missing ERAM bank 0x%02X: ignored.", ramBank);
+    return 0xFF;
+  }
+
+  return readInternal(address);
+}
+
+uint16_t MBC3::read16(uint16_t address) const {
+  DLOG_F(2, "Read16 mem[0x%04X]", address);
+  if (address == 0xFFFFu)
+    ABORT_F("Reading 16 bit value from interrupts enable register.");
+
+  uint16_t word = read8(address + 1);
+  word <<= 8u;
+  word |= read8(address);
+  return word;
+}
+
+void MBC3::write(uint16_t address, uint8_t data) {
+  DLOG_F(2, "Write8: mem[0x%04X] <- 0x%02X", address, data);
+  // RAM and timer enable.
+  if (address < 0x2000u) {
+    state.mapper.ramEnable = (data & 0x0Fu) == 0x0Au;
+  }
+  // ROM bank number, bank 0 maps to 1.
+  else if (address < 0x4000u) {
+    state.mapper.romBank = data & 0x7Fu;
+    if (state.mapper.romBank == 0)
+      state.mapper.romBank = 1;
+  }
+  // RAM bank number or RTC register select.
+  else if (address < 0x6000u) {
+    state.mapper.ramBank = data;
+  }
+  // Latch clock data on a 0x00 then 0x01 write.
+  else if (address < 0x8000u) {
+    if (timer && state.mapper.latch == 0x00 && data == 0x01)
+      rtc.latch();
+    state.mapper.latch = data;
+  }
+  // ERAM or RTC register.
+  else if (address >= 0xA000u && address < 0xC000u) {
+    uint8_t ramBank = state.mapper.ramBank;
+    if (!state.mapper.ramEnable)
+      LOG_F(WARNING, "Write to disabled ERAM: ignored.");
+    else if (ramBank < ramBanks)
+      state.ERAM[ramBank * kilo8 + address - 0xA000u] = data;
+    else if (timer && ramBank >= RealTimeClock::Seconds)
+      rtc.write(ramBank, data);
+    else
+      LOG_F(WARNING, "Write to missing ERAM bank 0x%02X: ignored.", ramBank);
+  }
+  else {
+    writeInternal(address, data);
+  }
+}
+
+void MBC3::write(uint16_t address, uint16_t data) {
+  DLOG_F(2, "Write16: mem[0x%04X] <- 0x%02X", address, data);
+  if (address == 0xFFFFu)
+    ABORT_F("Writing 16 bit value to interrupts enable register.");
+
+  write(address, static_cast<uint8_t>(data & 0xFFu));
+  write(static_cast<uint16_t>(address + 1), static_cast<uint8_t>((data & 0xFF00u) >> 8u));
+}
+
+void MBC3::reset() {
+  LOG_F(INFO, "Memory (MBC3) resetting.");
+
+  // Reset the banking registers.
+  state.mapper.ramEnable = 0;
+  state.mapper.romBank = 1;
+  state.mapper.ramBank = 0;
+  state.mapper.latch = 0xFF;
+
+  resetInternal();
+
+  LOG_F(INFO, "Memory (MBC3) finished resetting.");
+}
+
+void MBC3::saveBattery(std::ostream &out) const {
+  out.write(reinterpret_cast<const char *>(state.ERAM.data()), ramBanks * kilo8);
+  if (timer)
+    rtc.save(out);
+}
+
+void MBC3::loadBattery(std::istream &in) {
+  in.read(reinterpret_cast<char *>(state.ERAM.data()), ramBanks * kilo8);
+  DLOG_IF_F(WARNING, !in, "Battery save shorter than ERAM.");
+  if (timer && in)
+    rtc.load(in);
+}
@@ -0,0 +1,162 @@
+#include "sim/mem/MemoryController.h"
+
+#include "sim/apu/APU.h"
+#include "sim/ppu/PPU.h"
+#include "sim/timer/Timer.h"
+
+#include "loguru.hpp"
+
+uint8_t MemoryController::readInternal(uint16_t address) const {
+  // VRAM.
+  if (address >= 0x8000u && address < 0xA000u) {
+    return state.VRAM[address - 0x8000u];
+  }
+  // WRAM0.
+  else if (address >= 0xC000u && address < 0xD000u) {
+    return state.WRAM0[address - 0xC000u];
+  }
+  // WRAM1.
+  else if (address >= 0xD000u && address < 0xE000u) {
+    return state.WRAM1[address - 0xD000u];
+  }
+  // Echo RAM, mirroring 0xC000-0xDDFF.
+  else if (address >= 0xE000u && address < 0xFE00u) {
+    return readInternal(static_cast<uint16_t>(address - 0x2000u));
+  }
+  // Sprite attribute table.
+  else if (address >= 0xFE00u && address < 0xFEA0u) {
+    return state.SAT[address - 0xFE00u];
+  }
+  // Unusable range.
+  else if (address >= 0xFEA0u && address < 0xFF00u) {
+    LOG_F(WARNING, "Read from unusable: ignored.");
+    return 0xFF;
+  }
+  // I/O registers.
+  else if (address >= 0xFF00u && address < 0xFF80u) {
+    auto reg = static_cast<uint8_t>(address - 0xFF00u);
+    if (apu != nullptr && reg >= snd::NR10 && reg < snd::End)
+      return apu->read(reg);
+    if (timer != nullptr && reg >= tmr::DIV && reg < tmr::End)
+      return timer->read(reg);
+    return state.IO[reg];
+  }
+  // HRAM.
+  else if (address >= 0xFF80u && address < 0xFFFFu) {
+    return state.HRAM[address - 0xFF80u];
+  }
+  // Interrupts enable register.
+  else if (address == 0xFFFFu) {
+    return state.IE;
+  }
+
+  LOG_F(WARNING, "Read from cartridge address 0x%04X not handled.", address);
+  return 0xFF;
+}
+
+void MemoryController::writeInternal(uint16_t address, uint8_t data) {
+  // VRAM.
+  if (address >= 0x8000u && address < 0xA000u) {
+    uint16_t offset = static_cast<uint16_t>(address - 0x8000u);
+    state.VRAM[offset] = data;
+    if (ppu != nullptr)
+      ppu->vramWritten(offset);
+  }
+  // WRAM0.
+  else if (address >= 0xC000u && address < 0xD000u) {
+    state.WRAM0[address - 0xC000u] = data;
+  }
+  // WRAM1.
+  else if (address >= 0xD000u && address < 0xE000u) {
+    state.WRAM1[address - 0xD000u] = data;
+  }
+  // Echo RAM, mirroring 0xC000-0xDDFF.
+  else if (address >= 0xE000u && address < 0xFE00u) {
+    writeInternal(static_cast<uint16_t>(address - 0x2000u), data);
+  }
+  // Sprite attribute table.
+  else if (address >= 0xFE00u && address < 0xFEA0u) {
+    state.SAT[address - 0xFE00u] = data;
+    if (ppu != nullptr)
+      ppu->oamWritten(static_cast<uint8_t>(address - 0xFE00u));
+  }
+  // Unusable range.
+  else if (address >= 0xFEA0u && address < 0xFF00u) {
+    LOG_F(WARNING, "Write to unusable: ignored.");
+  }
+  // I/O registers.
+  else if (address >= 0xFF00u && address < 0xFF80u) {
+    writeIO(static_cast<uint8_t>(address - 0xFF00u), data);
+  }
+  // HRAM.
+  else if (address >= 0xFF80u && address < 0xFFFFu) {
+    state.HRAM[address - 0xFF80u] = data;
+  }
+  // Interrupts enable register.
+  else if (address == 0xFFFFu) {
+    state.IE = data;
+  }
+  else {
+    LOG_F(WARNING, "Write to cartridge address 0x%04X not handled.", address);
+  }
+}
+
+void MemoryController::writeIO(uint8_t reg, uint8_t data) {
+  // The sound registers belong to the APU, which first catches up to now.
+  if (apu != nullptr && reg >= snd::NR10 && reg < snd::End) {
+    apu->write(reg, data);
+    return;
+  }
+
+  // So do the divider and timer registers, to the timer.
+  if (timer != nullptr && reg >= tmr::DIV && reg < tmr::End) {
+    timer->write(reg, data);
+    return;
+  }
+
+  // The PPU catches up before the LCD may be switched on or off.
+  if (reg == lcd::LCDC && ppu != nullptr)
+    ppu->sync();
+
+  switch (reg) {
+  // Only the STAT interrupt selects are writable.
+  case lcd::STAT:
+    state.IO[reg] = static_cast<uint8_t>((state.IO[reg] & 0x07u) | (data & 0x78u) | 0x80u);
+    break;
+  // LY is read only.
+  case lcd::LY:
+    DLOG_F(1, "Write to LY: ignored.");
+    break;
+  // OAM DMA, done instantly.
+  case lcd::DMA: {
+    state.IO[reg] = data;
+    uint16_t source = static_cast<uint16_t>(data << 8u);
+    DLOG_F(1, "OAM DMA from 0x%04X.", source);
+    for (uint16_t i = 0; i < state.SAT.size(); ++i)
+      state.SAT[i] = read8(static_cast<uint16_t>(source + i));
+    if (ppu != nullptr)
+      ppu->oamReplaced();
+    break;
+  }
+  default:
+    state.IO[reg] = data;
+    break;
+  }
+
+  if (reg >= lcd::LCDC && reg <= lcd::WX && ppu != nullptr)
+    ppu->lcdWritten(reg, state.IO[reg]);
+}
+
+void MemoryController::resetInternal() {
+  // Reset the I/O registers.
+  DLOG_F(1, "Resetting I/O registers.");
+  for (const memdefaults::MemValue mv : memdefaults::ioRegs)
+    write(mv.location, mv.value);
+  DLOG_F(1, "Finished resetting I/O registers.");
+
+  // Reset the interrupt enable register.
+  DLOG_F(1, "Resetting IE register.");
+  const memdefaults::MemValue &ie = memdefaults::ie;
+  write(ie.location, ie.value);
+  DLOG_F(1, "Finished resetting IE register.");
+}
@@ -0,0 +1,182 @@
+#include "sim/mem/RealTimeClock.h"
+
+#include "loguru.hpp"
+
+#include <cstring>
+#include <ctime>
+#include <istream>
+#include <ostream>
+
+namespace {
+
+//! Seconds in one day.
+constexpr uint64_t secondsPerDay = 86400;
+
+//! The period of the 9-bit day counter in seconds.
+constexpr uint64_t counterPeriod = 512 * secondsPerDay;
+
+//! Write \p count little-endian bytes of \p value.
+void putLE(std::ostream &out, uint64_t value, unsigned count) {
+  for (unsigned i = 0; i < count; ++i)
+    out.put(static_cast<char>((value >> (8u * i)) & 0xFFu));
+}
+
+//! Read \p count little-endian bytes from \p buf.
+uint64_t getLE(const uint8_t *buf, unsigned count) {
+  uint64_t value = 0;
+  for (unsigned i = count; i > 0; --i)
+    value = (value << 8u) | buf[i - 1];
+  return value;
+}
+
+//! Convert register values back into a counter in seconds.
+uint64_t join(const uint8_t regs[5]) {
+  uint64_t days = regs[3] | ((regs[4] & 0x01u) << 8u);
+  return regs[0] + 60u * regs[1] + 3600u * regs[2] + secondsPerDay * days;
+}
+
+} // End anonymous namespace.
+
+RealTimeClock::RealTimeClock(RtcState &state, const uint64_t &clock)
+    : state(state), clock(clock) { }
+
+void RealTimeClock::reset() {
+  state.base = clock;
+  state.offset = 0;
+  state.haltedSub = 0;
+  state.halted = false;
+  state.carry = false;
+  std::memset(state.latched, 0, sizeof state.latched);
+}
+
+void RealTimeClock::latch() {
+  uint64_t seconds = counter();
+  split(seconds, state.halted, state.carry, state.latched);
+  const uint8_t *l = state.latched;
+  DLOG_F(1, "RTC latched: %ud %02u:%02u:%02u", l[3] | ((l[4] & 1u) << 8u), l[2], l[1], l[0]);
+}
+
+uint8_t RealTimeClock::read(uint8_t reg) const {
+  if (reg < Seconds || reg > DaysHigh) {
+    LOG_F(WARNING, "Read from invalid RTC register 0x%02X: ignored.", reg);
+    return 0xFF;
+  }
+  return state.latched[reg - Seconds];
+}
+
+void RealTimeClock::write(uint8_t reg, uint8_t value) {
+  uint64_t seconds = counter();
+  uint64_t sub = subSecond();
+
+  uint64_t s = seconds % 60;
+  uint64_t m = seconds / 60 % 60;
+  uint64_t h = seconds / 3600 % 24;
+  uint64_t d = seconds / secondsPerDay;
+
+  switch (reg) {
+  case Seconds:
+    // Writing seconds also resets the sub-second divider.
+    s = value & 0x3Fu;
+    sub = 0;
+    break;
+  case Minutes:
+    m = value & 0x3Fu;
+    break;
+  case Hours:
+    h = value & 0x1Fu;
+    break;
+  case DaysLow:
+    d = (d & 0x100u) | value;
+    break;
+  case DaysHigh:
+    d = (d & 0xFFu) | ((value & 0x01u) << 8u);
+    state.carry = (value & 0x80u) != 0;
+    state.halted = (value & 0x40u) != 0;
+    break;
+  default:
+    LOG_F(WARNING, "Write to invalid RTC register 0x%02X: ignored.", reg);
+    return;
+  }
+
+  rebase(s + 60 * m + 3600 * h + secondsPerDay * d, sub);
+}
+
+void RealTimeClock::save(std::ostream &out) const {
+  // Compute the live registers without folding, as saving is const.
+  uint64_t live = state.halted ? state.offset
+                                : state.offset + (clock - state.base) / cyclesPerSecond;
+  uint8_t regs[5];
+  split(live % counterPeriod, state.halted, state.carry || live >= counterPeriod, regs);
+
+  for (uint8_t reg : regs)
+    putLE(out, reg, 4);
+  for (uint8_t reg : state.latched)
+    putLE(out, reg, 4);
+  putLE(out, static_cast<uint64_t>(std::time(nullptr)), 8);
+}
+
+void RealTimeClock::load(std::istream &in) {
+  uint8_t buf[saveSize];
+  in.read(reinterpret_cast<char *>(buf), saveSize);
+  if (in.gcount() != static_cast<std::streamsize>(saveSize)) {
+    LOG_F(WARNING, "RTC save footer missing or truncated: clock reset.");
+    reset();
+    return;
+  }
+
+  uint8_t regs[5];
+  for (unsigned i = 0; i < 5; ++i) {
+    regs[i] = static_cast<uint8_t>(getLE(buf + 4 * i, 4));
+    state.latched[i] = static_cast<uint8_t>(getLE(buf + 20 + 4 * i, 4));
+  }
+  state.halted = (regs[4] & 0x40u) != 0;
+  state.carry = (regs[4] & 0x80u) != 0;
+
+  uint64_t seconds = join(regs);
+  auto saved = static_cast<int64_t>(getLE(buf + 40, 8));
+  auto now = static_cast<int64_t>(std::time(nullptr));
+  if (!state.halted && now > saved) {
+    DLOG_F(1, "RTC catching up %ld seconds of wall time.", static_cast<long>(now - saved));
+    seconds += static_cast<uint64_t>(now - saved);
+  }
+
+  rebase(seconds, 0);
+}
+
+uint64_t RealTimeClock::counter() {
+  int64_t seconds = state.halted ? state.offset
+                                 : state.offset + static_cast<int64_t>((clock - state.base) / cyclesPerSecond);
+
+  // Fold whole day counter periods into the sticky carry. Adjusting the offset
+  // rather than rebasing keeps the sub-second phase intact.
+  if (seconds >= static_cast<int64_t>(counterPeriod)) {
+    state.carry = true;
+    int64_t periods = seconds / static_cast<int64_t>(counterPeriod);
+    state.offset -= periods * static_cast<int64_t>(counterPeriod);
+    seconds -= periods * static_cast<int64_t>(counterPeriod);
+  }
+
+  return static_cast<uint64_t>(seconds);
+}
+
+uint64_t RealTimeClock::subSecond() const {
+  return state.halted ? state.haltedSub : (clock - state.base) % cyclesPerSecond;
+}
+
+void RealTimeClock::rebase(uint64_t seconds, uint64_t sub) {
+  state.offset = static_cast<int64_t>(seconds);
+  if (state.halted)
+    state.haltedSub = sub;
+  else
+    state.base = clock - sub;
+}
+
+void RealTimeClock::split(uint64_t seconds, bool halted, bool carry, uint8_t regs[5]) {
+  uint64_t days = seconds / secondsPerDay;
+  regs[0] = static_cast<uint8_t>(seconds % 60);
+  regs[1] = static_cast<uint8_t>(seconds / 60 % 60);
+  regs[2] = static_cast<uint8_t>(seconds / 3600 % 24);
+  regs[3] = static_cast<uint8_t>(days & 0xFFu);
+  regs[4] = static_cast<uint8_t>(((days >> 8u) & 0x01u) | (halted ? 0x40u : 0u) |
+                                 (carry ? 0x80u : 0u));
+}
@@ -0,0 +1,60 @@
+#include "sim/ppu/BgMapCache.h"
+
+#include <cstring>
+
+void BgMapCache::invalidateAll() {
+  for (Map &map : maps) {
+    for (uint64_t &word : map.dirty)
+      word = ~0ull;
+    map.unsignedTiles = false;
+  }
+  for (uint64_t &word : written)
+    word = 0;
+  tilesWritten = false;
+}
+
+const uint8_t *BgMapCache::row(unsigned map, bool unsignedTiles, unsigned y, const uint8_t *vram,
+                               TileCache &tiles) {
+  Map &m = maps[map];
+  if (m.unsignedTiles != unsignedTiles) {
+    for (uint64_t &word : m.dirty)
+      word = ~0ull;
+    m.unsignedTiles = unsignedTiles;
+  }
+  if (tilesWritten)
+    resolveWrittenTiles(vram);
+
+  // A row of cells is half a dirty word.
+  unsigned cellRow = y / 8u;
+  unsigned shift = (cellRow & 1u) * 32u;
+  uint64_t &word = m.dirty[cellRow / 2u];
+  auto cells = static_cast<uint32_t>(word >> shift);
+  if (cells != 0) {
+    const uint8_t *entries = vram + TileCache::tileDataSize + map * 0x400u + cellRow * 32u;
+    uint8_t *origin = &m.pixels[cellRow * 8u][0];
+    while (cells != 0) {
+      unsigned cell = static_cast<unsigned>(__builtin_ctz(cells));
+      const uint8_t *tile = tiles.tile(TileCache::mapTile(entries[cell], unsignedTiles), vram);
+      for (unsigned r = 0; r < 8; ++r)
+        std::memcpy(origin + r * mapSize + cell * 8u, tile + r * 8u, 8);
+      cells &= cells - 1u;
+    }
+    word &= ~(0xFFFFFFFFull << shift);
+  }
+  return m.pixels[y];
+}
+
+void BgMapCache::resolveWrittenTiles(const uint8_t *vram) {
+  for (unsigned map = 0; map < 2; ++map) {
+    Map &m = maps[map];
+    const uint8_t *entries = vram + TileCache::tileDataSize + map * 0x400u;
+    for (unsigned cell = 0; cell < 1024; ++cell) {
+      unsigned tile = TileCache::mapTile(entries[cell], m.unsignedTiles);
+      if (written[tile >> 6u] & (1ull << (tile & 63u)))
+        m.dirty[cell >> 6u] |= 1ull << (cell & 63u);
+    }
+  }
+  for (uint64_t &word : written)
+    word = 0;
+  tilesWritten = false;
+}
@@ -0,0 +1,135 @@
+#include "sim/ppu/Observation.h"
+
+#include "sim/ppu/Renderer.h"
+
+#include "loguru.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+//! out[i] = in[2i] + in[2i + 1] for \p count outputs. Inputs must be small
+//! enough that the sums fit in a byte.
+void pairSums(const uint8_t *in, unsigned count, uint8_t *out) {
+  unsigned i = 0;
+#if defined(__SSE2__)
+  const __m128i low = _mm_set1_epi16(0x00FF);
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2 + 16));
+    a = _mm_add_epi16(_mm_and_si128(a, low), _mm_srli_epi16(a, 8));
+    b = _mm_add_epi16(_mm_and_si128(b, low), _mm_srli_epi16(b, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(a, b));
+  }
+#endif
+  for (; i < count; ++i)
+    out[i] = static_cast<uint8_t>(in[i * 2] + in[i * 2 + 1]);
+}
+
+//! sums[i] += add[i] for \p count bytes.
+void accumulate(uint8_t *sums, const uint8_t *add, unsigned count) {
+  unsigned i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= count; i += 16) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + i));
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(add + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i), _mm_add_epi8(s, a));
+  }
+#endif
+  for (; i < count; ++i)
+    sums[i] = static_cast<uint8_t>(sums[i] + add[i]);
+}
+
+/**
+ * \brief Turn shade sums over 2^shift pixels into luminance.
+ *
+ * Luminance is linear in the shade (0xFF - 0x55 * shade), so the mean
+ * luminance comes straight from the shade sum.
+ */
+void luminance(const uint8_t *sums, unsigned count, unsigned shift, uint8_t *out) {
+  unsigned round = (1u << shift) >> 1u;
+  unsigned i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i k85 = _mm_set1_epi16(0x55);
+  const __m128i bias = _mm_set1_epi16(static_cast<short>(round));
+  const __m128i white = _mm_set1_epi16(0xFF);
+  const __m128i shiftBy = _mm_cvtsi32_si128(static_cast<int>(shift));
+  for (; i + 16 <= count; i += 16) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + i));
+    __m128i lo = _mm_srl_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), k85), bias), shiftBy);
+    __m128i hi = _mm_srl_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), k85), bias), shiftBy);
+    __m128i grey = _mm_packus_epi16(_mm_sub_epi16(white, lo), _mm_sub_epi16(white, hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), grey);
+  }
+#endif
+  for (; i < count; ++i)
+    out[i] = static_cast<uint8_t>(0xFFu - ((sums[i] * 0x55u + round) >> shift));
+}
+
+} // End anonymous namespace.
+
+bool ObservationWriter::valid(const ObservationSpec &spec) {
+  bool factorOk = spec.factor == 1 || spec.factor == 2 || spec.factor == 4;
+  return factorOk && spec.ring != nullptr && spec.slots != 0 && spec.cropWidth != 0 &&
+         spec.cropHeight != 0 && spec.cropWidth % spec.factor == 0 &&
+         spec.cropHeight % spec.factor == 0 && spec.cropX + spec.cropWidth <= lcd::width &&
+         spec.cropY + spec.cropHeight <= lcd::height;
+}
+
+ObservationWriter::ObservationWriter(const ObservationSpec &spec)
+    : spec(spec), sums(), started(false), completed(0) {
+  DLOG_F(1, "Observations: %ux%u at (%u, %u) / %u, %u slots.", spec.cropWidth, spec.cropHeight,
+         spec.cropX, spec.cropY, spec.factor, spec.slots);
+}
+
+void ObservationWriter::line(unsigned ly, const uint8_t *shades) {
+  if (ly < spec.cropY || ly >= spec.cropY + spec.cropHeight)
+    return;
+
+  unsigned row = ly - spec.cropY;
+  if (row == 0)
+    started = true;
+  else if (!started)
+    return;
+  unsigned width = spec.width();
+  const uint8_t *src = shades + spec.cropX;
+
+  // Sum each row of factor x factor boxes horizontally first.
+  uint8_t pairs[lcd::width / 2];
+  uint8_t boxes[lcd::width];
+  const uint8_t *horizontal = boxes;
+  switch (spec.factor) {
+  case 1:
+    horizontal = src;
+    break;
+  case 2:
+    pairSums(src, width, boxes);
+    break;
+  default:
+    pairSums(src, width * 2, pairs);
+    pairSums(pairs, width, boxes);
+    break;
+  }
+
+  if (row % spec.factor == 0)
+    std::memcpy(sums, horizontal, width);
+  else
+    accumulate(sums, horizontal, width);
+
+  if (row % spec.factor != spec.factor - 1)
+    return;
+
+  // The box is complete: write the observation row.
+  uint64_t n = completed.load(std::memory_order_relaxed);
+  uint8_t *out = spec.ring + (n % spec.slots) * spec.size() + (row / spec.factor) * width;
+  unsigned shift = spec.factor == 1 ? 0u : spec.factor == 2 ? 2u : 4u;
+  luminance(sums, width, shift, out);
+
+  if (row + 1 == spec.cropHeight)
+    completed.store(n + 1, std::memory_order_release);
+}
@@ -0,0 +1,330 @@
+#include "sim/ppu/PPU.h"
+
+#include "sim/MachineState.h"
+#include "sim/SharedFrameSink.h"
+#include "sim/ppu/TileDecoder.h"
+
+#include "loguru.hpp"
+
+#include <algorithm>
+
+PPU::PPU(MachineState &state, Scheduler &scheduler, Compose compose)
+    : state(state), scheduler(scheduler),
+      renderer(compose == Compose::Inline || compose == Compose::Deferred
+                   ? std::make_unique<Renderer>() : nullptr),
+      rasterLog(compose == Compose::Deferred ? std::make_unique<RasterLog>() : nullptr),
+      worker(compose == Compose::Thread ? std::make_unique<RenderThread>() : nullptr),
+      framebuffer(), sink(nullptr), skipFrames(0), skipPeriod(1), composedEnd(0) { }
+
+void PPU::reset() {
+  DLOG_F(1, "Resetting PPU, %s tile decoder.", TileDecoder::name());
+  state.ppu = PpuState();
+  state.ppu.synced = state.cycles;
+  composedEnd = 0;
+  vramReplaced();
+  state.IO[lcd::LY] = 0;
+  schedule();
+}
+
+void PPU::sync() {
+  PpuState &p = state.ppu;
+
+  // Events come at least once a frame, unless the clock was advanced
+  // further at once. The LCD is switched on or off even if no time passed.
+  uint64_t elapsed = state.cycles - p.synced;
+  do {
+    auto cycles = static_cast<uint32_t>(std::min<uint64_t>(elapsed, frameDots));
+    advance(cycles);
+    elapsed -= cycles;
+  } while (elapsed > 0);
+  p.synced = state.cycles;
+  schedule();
+}
+
+void PPU::schedule() {
+  const PpuState &p = state.ppu;
+
+  // The LCD is switched on or off at the next catch up.
+  if (!(state.IO[lcd::LCDC] & lcd::LcdEnable) == !!p.lcdOn) {
+    scheduler.schedule(Scheduler::Ppu, p.synced);
+    return;
+  }
+
+  // The dot the next mode change, or frame with the LCD off, happens at.
+  // advance() leaves the dot short of it, so it is always ahead.
+  uint32_t end = frameDots;
+  if (p.lcdOn) {
+    switch (p.mode) {
+    case OamScan:
+      end = oamScanDots;
+      break;
+    case Transfer:
+      end = p.transferEnd;
+      break;
+    default:
+      end = lineDots;
+      break;
+    }
+  }
+  scheduler.schedule(Scheduler::Ppu, p.synced + (end - p.dot));
+}
+
+void PPU::advance(uint32_t cycles) {
+  PpuState &p = state.ppu;
+  uint8_t *io = state.IO.data();
+
+  // With the LCD off LY and the mode are held at 0 and nothing is composed.
+  // Frames still pass, without interrupts, so whoever paces itself by them
+  // keeps going; the framebuffer and frame hash keep the last picture.
+  if (!(io[lcd::LCDC] & lcd::LcdEnable)) {
+    if (p.lcdOn) {
+      DLOG_F(1, "LCD off.");
+      p.lcdOn = 0;
+      p.dot = 0;
+      p.statLine = 0;
+      p.mode = HBlank;
+      io[lcd::LY] = 0;
+      io[lcd::STAT] &= 0xFCu;
+    }
+    p.dot += cycles;
+    while (p.dot >= frameDots) {
+      p.dot -= frameDots;
+      ++p.frame;
+    }
+    return;
+  }
+
+  // The LCD restarts at the top of a frame.
+  if (!p.lcdOn) {
+    DLOG_F(1, "LCD on.");
+    p.lcdOn = 1;
+    p.dot = 0;
+    p.windowLine = 0;
+    io[lcd::LY] = 0;
+    startLine();
+  }
+
+  uint32_t dot = p.dot + cycles;
+  bool more = true;
+  while (more) {
+    switch (p.mode) {
+    case OamScan:
+      if ((more = dot >= oamScanDots)) {
+        // Each sprite on the line stalls the pixel transfer.
+        unsigned stall = (io[lcd::LCDC] & lcd::ObjEnable) ? 6u * p.spriteCount : 0u;
+        p.transferEnd = static_cast<uint16_t>(oamScanDots + transferDots + (io[lcd::SCX] & 7u) + stall);
+        enterMode(Transfer);
+      }
+      break;
+    case Transfer:
+      if ((more = dot >= p.transferEnd)) {
+        renderLine();
+        enterMode(HBlank);
+      }
+      break;
+    case HBlank:
+      if ((more = dot >= lineDots)) {
+        dot -= lineDots;
+        if (++io[lcd::LY] == lcd::height) {
+          bool composed = false;
+          if (composing()) {
+            if (worker != nullptr)
+              worker->endFrame(p.frame);
+            composed = rasterLog == nullptr ||
+                       rasterLog->replay(*renderer, state.VRAM.data(), state.SAT.data(),
+                                         framebuffer, observer.get());
+            if (composed)
+              composedEnd = p.frame + 1;
+          }
+          ++p.frame;
+          enterMode(VBlank);
+          interrupt(irq::VBlank);
+          // Frames skipped have nothing new to show.
+          if (composed && sink != nullptr)
+            publish();
+        }
+        else {
+          startLine();
+        }
+      }
+      break;
+    case VBlank:
+      if ((more = dot >= lineDots)) {
+        dot -= lineDots;
+        if (++io[lcd::LY] == frameLines) {
+          io[lcd::LY] = 0;
+          p.windowLine = 0;
+          startLine();
+        }
+        else {
+          updateStat();
+        }
+      }
+      break;
+    }
+  }
+  p.dot = dot;
+}
+
+void PPU::setFramebuffer(const Framebuffer &fb) {
+  if (headless()) {
+    LOG_IF_F(WARNING, fb.pixels != nullptr, "Headless PPU: framebuffer ignored.");
+    return;
+  }
+  framebuffer = fb;
+  if (framebuffer.pitch == 0)
+    framebuffer.pitch = lcd::width * pixelfmt::bytesPerPixel(fb.format);
+}
+
+void PPU::attachSink(SharedFrameSink *s) {
+  if (headless()) {
+    LOG_IF_F(WARNING, s != nullptr, "Headless PPU: frame sink ignored.");
+    return;
+  }
+
+  // Queued lines go to the old sink's framebuffer, which goes away with it.
+  drain();
+  if (sink != nullptr)
+    setFramebuffer(Framebuffer());
+  sink = s;
+  if (sink != nullptr)
+    setFramebuffer(sink->framebuffer());
+}
+
+void PPU::publish() {
+  uint64_t frame = state.ppu.frame - 1;
+  waitComposed(frame);
+  sink->publish(frame, frameHash(), state);
+  setFramebuffer(sink->framebuffer());
+}
+
+void PPU::waitComposed(uint64_t frame) const {
+  // A frame that wasn't composed leaves the one composed before it.
+  if (worker != nullptr && frame < state.ppu.frame)
+    worker->waitFrames(std::min(frame + 1, composedEnd));
+}
+
+bool PPU::setObservation(const ObservationSpec &spec) {
+  if (headless()) {
+    LOG_IF_F(WARNING, spec.ring != nullptr, "Headless PPU: observations ignored.");
+    return spec.ring == nullptr;
+  }
+
+  // Queued lines may still feed the current observations.
+  drain();
+  if (spec.ring == nullptr) {
+    observer.reset();
+    return true;
+  }
+  if (!ObservationWriter::valid(spec)) {
+    LOG_F(ERROR, "Invalid observation: %ux%u at (%u, %u) / %u.", spec.cropWidth, spec.cropHeight,
+          spec.cropX, spec.cropY, spec.factor);
+    observer.reset();
+    return false;
+  }
+  observer = std::make_unique<ObservationWriter>(spec);
+  return true;
+}
+
+void PPU::setFrameSkip(unsigned skip, unsigned period) {
+  if (period == 0 || skip >= period) {
+    LOG_F(ERROR, "Invalid frame skip %u of %u: composing every frame.", skip, period);
+    skip = 0;
+    period = 1;
+  }
+  skipFrames = skip;
+  skipPeriod = period;
+}
+
+void PPU::lcdWritten(uint8_t reg, uint8_t value) {
+  if (rasterLog != nullptr)
+    rasterLog->record(reg, value);
+
+  // Switching the LCD on or off changes the timing, caught up to the
+  // write by MemoryController.
+  if (reg == lcd::LCDC)
+    schedule();
+}
+
+void PPU::oamWritten(uint8_t offset) {
+  spriteIndex.written(offset, state.SAT.data());
+  if (worker != nullptr)
+    worker->oamWritten();
+}
+
+void PPU::oamReplaced() {
+  spriteIndex.rebuild(state.SAT.data());
+  if (worker != nullptr)
+    worker->oamWritten();
+}
+
+void PPU::enterMode(Mode mode) {
+  state.ppu.mode = mode;
+  state.IO[lcd::STAT] = static_cast<uint8_t>((state.IO[lcd::STAT] & 0xFCu) | mode);
+  updateStat();
+}
+
+void PPU::startLine() {
+  PpuState &p = state.ppu;
+
+  // The first ten sprites in OAM order that overlap the line.
+  bool tall = state.IO[lcd::LCDC] & lcd::ObjSize;
+  p.spriteCount = static_cast<uint8_t>(spriteIndex.select(state.IO[lcd::LY], tall, p.sprites));
+
+  // Deferred frames are logged from the registers at the top of the frame.
+  if (rasterLog != nullptr && state.IO[lcd::LY] == 0)
+    rasterLog->begin(state.IO.data());
+
+  enterMode(OamScan);
+}
+
+void PPU::renderLine() {
+  const uint8_t *io = state.IO.data();
+  LineRegs regs {io[lcd::LCDC], io[lcd::SCY], io[lcd::SCX], io[lcd::WY], io[lcd::WX],
+                 io[lcd::BGP], io[lcd::OBP0], io[lcd::OBP1], io[lcd::LY], state.ppu.windowLine};
+
+  if (composing()) {
+    uint8_t *out = framebuffer.pixels != nullptr ? framebuffer.line(regs.ly) : nullptr;
+    if (worker != nullptr) {
+      worker->line(state.VRAM.data(), state.SAT.data(), regs, state.ppu.sprites,
+                   state.ppu.spriteCount, out, framebuffer.format, observer.get());
+    }
+    else if (rasterLog != nullptr) {
+      rasterLog->markLine(regs.ly, state.ppu.sprites, state.ppu.spriteCount);
+    }
+    else {
+      const uint8_t *shades = renderer->renderLine(regs, state.VRAM.data(), state.SAT.data(),
+                                                   state.ppu.sprites, state.ppu.spriteCount, out,
+                                                   framebuffer.format);
+      if (observer != nullptr)
+        observer->line(regs.ly, shades);
+    }
+  }
+
+  // The window line only advances on lines the window was drawn on.
+  if (Renderer::windowVisible(regs))
+    ++state.ppu.windowLine;
+}
+
+bool PPU::composing() const {
+  return (framebuffer.pixels != nullptr || observer != nullptr) && composes(state.ppu.frame);
+}
+
+void PPU::updateStat() {
+  uint8_t &stat = state.IO[lcd::STAT];
+  bool coincidence = state.IO[lcd::LY] == state.IO[lcd::LYC];
+  stat = static_cast<uint8_t>((stat & ~0x04u) | (coincidence ? 0x04u : 0u));
+
+  // The STAT interrupt sources are ORed together; the interrupt fires when
+  // the combined line rises.
+  uint8_t mode = state.ppu.mode;
+  bool line = ((stat & 0x08u) && mode == HBlank) || ((stat & 0x10u) && mode == VBlank) ||
+              ((stat & 0x20u) && mode == OamScan) || ((stat & 0x40u) && coincidence);
+  if (line && !state.ppu.statLine)
+    interrupt(irq::Stat);
+  state.ppu.statLine = line;
+}
+
+void PPU::interrupt(uint8_t bit) {
+  state.IO[irq::IF] |= bit;
+}
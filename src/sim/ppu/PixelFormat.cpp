@@ -0,0 +1,129 @@
+#include "sim/ppu/PixelFormat.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+//! Each shade's pixel in every format.
+constexpr uint8_t gray8[4] = {0xFF, 0xAA, 0x55, 0x00};
+constexpr uint16_t rgb565[4] = {0xFFFF, 0xAD55, 0x52AA, 0x0000};
+// Stored little endian, so R, G, B, then A in memory.
+constexpr uint32_t rgba8888[4] = {0xFFFFFFFFu, 0xFFAAAAAAu, 0xFF555555u, 0xFF000000u};
+
+//! Convert one pixel at a time.
+template <typename T>
+void convertScalar(const T (&colours)[4], const uint8_t *shades, unsigned count, uint8_t *out) {
+  for (unsigned i = 0; i < count; ++i) {
+    T pixel = colours[shades[i] & 3u];
+    std::memcpy(out + i * sizeof(T), &pixel, sizeof(T));
+  }
+}
+
+#if defined(__SSE2__)
+
+/**
+ * \brief Select one of four colours per lane by shade.
+ *
+ * Shades are few enough that comparing against each and masking in its
+ * colour beats a gather, and needs nothing past SSE2.
+ */
+template <unsigned Bits>
+inline __m128i select(__m128i shades, const __m128i (&colours)[4]) {
+  __m128i out = _mm_setzero_si128();
+  for (int s = 0; s < 4; ++s) {
+    __m128i match;
+    if constexpr (Bits == 8)
+      match = _mm_cmpeq_epi8(shades, _mm_set1_epi8(static_cast<char>(s)));
+    else if constexpr (Bits == 16)
+      match = _mm_cmpeq_epi16(shades, _mm_set1_epi16(static_cast<short>(s)));
+    else
+      match = _mm_cmpeq_epi32(shades, _mm_set1_epi32(s));
+    out = _mm_or_si128(out, _mm_and_si128(match, colours[s]));
+  }
+  return out;
+}
+
+inline __m128i set8(int v) { return _mm_set1_epi8(static_cast<char>(v)); }
+inline __m128i set16(int v) { return _mm_set1_epi16(static_cast<short>(v)); }
+inline __m128i set32(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+
+void convertGray8(const uint8_t *shades, unsigned count, uint8_t *out) {
+  const __m128i colours[4] = {set8(gray8[0]), set8(gray8[1]), set8(gray8[2]), set8(gray8[3])};
+  unsigned i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(shades + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), select<8>(s, colours));
+  }
+  convertScalar(gray8, shades + i, count - i, out + i);
+}
+
+void convertRgb565(const uint8_t *shades, unsigned count, uint8_t *out) {
+  const __m128i colours[4] = {set16(rgb565[0]), set16(rgb565[1]), set16(rgb565[2]), set16(rgb565[3])};
+  const __m128i zero = _mm_setzero_si128();
+  unsigned i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(shades + i));
+    __m128i *dst = reinterpret_cast<__m128i *>(out + i * 2);
+    _mm_storeu_si128(dst, select<16>(_mm_unpacklo_epi8(s, zero), colours));
+    _mm_storeu_si128(dst + 1, select<16>(_mm_unpackhi_epi8(s, zero), colours));
+  }
+  convertScalar(rgb565, shades + i, count - i, out + i * 2);
+}
+
+void convertRgba8888(const uint8_t *shades, unsigned count, uint8_t *out) {
+  const __m128i colours[4] = {set32(rgba8888[0]), set32(rgba8888[1]), set32(rgba8888[2]),
+                              set32(rgba8888[3])};
+  const __m128i zero = _mm_setzero_si128();
+  unsigned i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(shades + i));
+    __m128i lo = _mm_unpacklo_epi8(s, zero);
+    __m128i hi = _mm_unpackhi_epi8(s, zero);
+    __m128i quads[4] = {_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                        _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+    __m128i *dst = reinterpret_cast<__m128i *>(out + i * 4);
+    for (int q = 0; q < 4; ++q)
+      _mm_storeu_si128(dst + q, select<32>(quads[q], colours));
+  }
+  convertScalar(rgba8888, shades + i, count - i, out + i * 4);
+}
+
+#else
+
+void convertGray8(const uint8_t *shades, unsigned count, uint8_t *out) {
+  convertScalar(gray8, shades, count, out);
+}
+
+void convertRgb565(const uint8_t *shades, unsigned count, uint8_t *out) {
+  convertScalar(rgb565, shades, count, out);
+}
+
+void convertRgba8888(const uint8_t *shades, unsigned count, uint8_t *out) {
+  convertScalar(rgba8888, shades, count, out);
+}
+
+#endif // __SSE2__
+
+} // End anonymous namespace.
+
+void pixelfmt::convert(PixelFormat format, const uint8_t *shades, unsigned count, void *out) {
+  auto *dst = static_cast<uint8_t *>(out);
+  switch (format) {
+  case PixelFormat::Index8:
+    std::memcpy(dst, shades, count);
+    break;
+  case PixelFormat::Gray8:
+    convertGray8(shades, count, dst);
+    break;
+  case PixelFormat::RGB565:
+    convertRgb565(shades, count, dst);
+    break;
+  case PixelFormat::RGBA8888:
+    convertRgba8888(shades, count, dst);
+    break;
+  }
+}
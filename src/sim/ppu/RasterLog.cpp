@@ -0,0 +1,66 @@
+#include "sim/ppu/RasterLog.h"
+
+#include "loguru.hpp"
+
+#include <cstring>
+
+RasterLog::RasterLog() : start(), lines(), marked(0), valid(false) {
+  // Enough for a write or two to every register on every line.
+  events.reserve(2048);
+}
+
+void RasterLog::begin(const uint8_t *io) {
+  std::memcpy(start, io + lcd::LCDC, sizeof start);
+  events.clear();
+  marked = 0;
+  valid = true;
+}
+
+void RasterLog::markLine(uint8_t ly, const uint8_t *sprites, unsigned spriteCount) {
+  if (!valid)
+    return;
+
+  // Lines arrive in order from the first; anything else means the log missed
+  // part of the frame.
+  if (ly != marked || ly >= lcd::height) {
+    DLOG_F(1, "Raster log out of step at line %u, dropping frame.", ly);
+    valid = false;
+    return;
+  }
+
+  LineMark &mark = lines[marked++];
+  mark.events = static_cast<uint32_t>(events.size());
+  mark.spriteCount = static_cast<uint8_t>(spriteCount);
+  std::memcpy(mark.sprites, sprites, spriteCount);
+}
+
+bool RasterLog::replay(Renderer &renderer, const uint8_t *vram, const uint8_t *oam,
+                       const Framebuffer &framebuffer, ObservationWriter *observer) {
+  if (!valid || marked != lcd::height)
+    return false;
+
+  uint8_t io[sizeof start];
+  std::memcpy(io, start, sizeof io);
+
+  std::size_t next = 0;
+  uint8_t windowLine = 0;
+  for (unsigned ly = 0; ly < lcd::height; ++ly) {
+    const LineMark &mark = lines[ly];
+    for (; next < mark.events; ++next)
+      io[events[next].reg - lcd::LCDC] = events[next].value;
+
+    auto reg = [&io](lcd::Reg r) { return io[r - lcd::LCDC]; };
+    LineRegs regs {reg(lcd::LCDC), reg(lcd::SCY), reg(lcd::SCX), reg(lcd::WY), reg(lcd::WX),
+                   reg(lcd::BGP), reg(lcd::OBP0), reg(lcd::OBP1), static_cast<uint8_t>(ly),
+                   windowLine};
+    uint8_t *out = framebuffer.pixels != nullptr ? framebuffer.line(ly) : nullptr;
+    const uint8_t *shades = renderer.renderLine(regs, vram, oam, mark.sprites, mark.spriteCount,
+                                                out, framebuffer.format);
+    if (observer != nullptr)
+      observer->line(ly, shades);
+
+    if (Renderer::windowVisible(regs))
+      ++windowLine;
+  }
+  return true;
+}
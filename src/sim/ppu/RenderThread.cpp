@@ -0,0 +1,157 @@
+#include "sim/ppu/RenderThread.h"
+
+#include "loguru.hpp"
+
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+//! Empty polls before the render thread starts sleeping between polls.
+constexpr unsigned spinPolls = 1024;
+
+} // End anonymous namespace.
+
+RenderThread::RenderThread()
+    : ring(std::make_unique<SpscRing<RenderCommand, 4096>>()), composed(0), fences(0), fenced(0),
+      running(true), shadowVram(), shadowOam() {
+  replaced();
+  thread = std::thread(&RenderThread::work, this);
+}
+
+RenderThread::~RenderThread() {
+  running.store(false, std::memory_order_release);
+  thread.join();
+}
+
+void RenderThread::replaced() {
+  for (uint64_t &word : vramDirty)
+    word = ~0ull;
+  oamDirty = true;
+}
+
+void RenderThread::line(const uint8_t *vram, const uint8_t *oam, const LineRegs &regs,
+                        const uint8_t *sprites, unsigned spriteCount, uint8_t *out,
+                        PixelFormat format, ObservationWriter *observer) {
+  flush(vram, oam);
+
+  RenderCommand command;
+  command.kind = RenderCommand::Line;
+  command.line.regs = regs;
+  command.line.spriteCount = static_cast<uint8_t>(spriteCount);
+  std::memcpy(command.line.sprites, sprites, spriteCount);
+  command.line.format = format;
+  command.line.out = out;
+  command.line.observer = observer;
+  send(command);
+}
+
+void RenderThread::endFrame(uint64_t frame) {
+  RenderCommand command;
+  command.kind = RenderCommand::Frame;
+  command.frame = frame;
+  send(command);
+}
+
+void RenderThread::waitFrames(uint64_t frames) const {
+  while (composedFrames() < frames)
+    std::this_thread::yield();
+}
+
+void RenderThread::drain() {
+  RenderCommand command;
+  command.kind = RenderCommand::Fence;
+  command.fence = ++fences;
+  send(command);
+  while (fenced.load(std::memory_order_acquire) < fences)
+    std::this_thread::yield();
+}
+
+void RenderThread::send(const RenderCommand &command) {
+  if (ring->push(command))
+    return;
+
+  // The render thread is a whole ring behind; wait rather than drop, as a
+  // dropped update would leave its shadow VRAM wrong for good.
+  DLOG_F(2, "Render ring full, waiting.");
+  while (!ring->push(command))
+    std::this_thread::yield();
+}
+
+void RenderThread::flush(const uint8_t *vram, const uint8_t *oam) {
+  RenderCommand command;
+  command.kind = RenderCommand::Vram;
+  for (unsigned w = 0; w < 4; ++w) {
+    while (vramDirty[w] != 0) {
+      unsigned block = w * 64u + static_cast<unsigned>(__builtin_ctzll(vramDirty[w]));
+      vramDirty[w] &= vramDirty[w] - 1;
+      command.update.offset = static_cast<uint16_t>(block * RenderCommand::blockSize);
+      std::memcpy(command.update.bytes, vram + command.update.offset, RenderCommand::blockSize);
+      send(command);
+    }
+  }
+
+  if (!oamDirty)
+    return;
+  oamDirty = false;
+  command.kind = RenderCommand::Oam;
+  for (uint16_t offset = 0; offset < sizeof shadowOam; offset += RenderCommand::blockSize) {
+    command.update.offset = offset;
+    std::memcpy(command.update.bytes, oam + offset, RenderCommand::blockSize);
+    send(command);
+  }
+}
+
+void RenderThread::work() {
+  loguru::set_thread_name("render");
+  DLOG_F(1, "Render thread started.");
+
+  RenderCommand command;
+  unsigned idle = 0;
+  while (running.load(std::memory_order_acquire)) {
+    if (ring->pop(command)) {
+      apply(command);
+      idle = 0;
+    }
+    else if (++idle < spinPolls) {
+      std::this_thread::yield();
+    }
+    else {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  // Lines queued before stopping still belong in the caller's framebuffer.
+  while (ring->pop(command))
+    apply(command);
+
+  DLOG_F(1, "Render thread stopped.");
+}
+
+void RenderThread::apply(const RenderCommand &command) {
+  switch (command.kind) {
+  case RenderCommand::Vram:
+    std::memcpy(shadowVram + command.update.offset, command.update.bytes, RenderCommand::blockSize);
+    // A block spans two tiles or 32 tile map entries.
+    for (unsigned i = 0; i < RenderCommand::blockSize; ++i)
+      renderer.vramWritten(static_cast<uint16_t>(command.update.offset + i));
+    break;
+  case RenderCommand::Oam:
+    std::memcpy(shadowOam + command.update.offset, command.update.bytes, RenderCommand::blockSize);
+    break;
+  case RenderCommand::Line: {
+    const uint8_t *shades = renderer.renderLine(command.line.regs, shadowVram, shadowOam,
+                                                command.line.sprites, command.line.spriteCount,
+                                                command.line.out, command.line.format);
+    if (command.line.observer != nullptr)
+      command.line.observer->line(command.line.regs.ly, shades);
+    break;
+  }
+  case RenderCommand::Frame:
+    composed.store(command.frame + 1, std::memory_order_release);
+    break;
+  case RenderCommand::Fence:
+    fenced.store(command.fence, std::memory_order_release);
+    break;
+  }
+}
@@ -0,0 +1,181 @@
+#include "sim/ppu/Renderer.h"
+
+#include "sim/util/Hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+//! Sprite pixel bits in Renderer::objLine.
+enum ObjPixel : uint8_t {
+  ObjColour = 0x03,   //< The colour index, 0 where no sprite is opaque.
+  ObjPalette = 0x04,  //< OBP1 rather than OBP0.
+  ObjBehind = 0x08    //< BG colours 1-3 are drawn over the sprite.
+};
+
+/**
+ * \brief Mix BG and sprite pixels into shades.
+ *
+ * Each pixel picks a source index, the BG colour (0-3) or 8 + the sprite
+ * colour and palette bit (9-15), from byte masks, then its shade from
+ * \p shades. No pixel takes a branch.
+ *
+ * \param bg BG/window colour indices.
+ * \param obj Sprite pixels, see ObjPixel.
+ * \param shades The shade of each source index.
+ * \param count The number of pixels.
+ * \param out The shades.
+ */
+void mix(const uint8_t *bg, const uint8_t *obj, const uint8_t *shades, unsigned count,
+         uint8_t *out) {
+  unsigned x = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i colour = _mm_set1_epi8(ObjColour);
+  const __m128i behind = _mm_set1_epi8(ObjBehind);
+  const __m128i objSource = _mm_set1_epi8(0x08);
+  const __m128i objBits = _mm_set1_epi8(ObjColour | ObjPalette);
+  for (; x + 16 <= count; x += 16) {
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bg + x));
+    __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i *>(obj + x));
+
+    // A sprite pixel shows if opaque, unless behind a BG colour 1-3.
+    __m128i transparent = _mm_cmpeq_epi8(_mm_and_si128(o, colour), zero);
+    __m128i hidden = _mm_andnot_si128(_mm_cmpeq_epi8(b, zero),
+                                      _mm_cmpeq_epi8(_mm_and_si128(o, behind), behind));
+    __m128i showBg = _mm_or_si128(transparent, hidden);
+    __m128i objIndex = _mm_or_si128(_mm_and_si128(o, objBits), objSource);
+    __m128i source = _mm_or_si128(_mm_and_si128(showBg, b), _mm_andnot_si128(showBg, objIndex));
+
+    // Look the shade up by comparing against every source index in use.
+    __m128i shade = zero;
+    for (unsigned i : {0u, 1u, 2u, 3u, 9u, 10u, 11u, 13u, 14u, 15u}) {
+      __m128i match = _mm_cmpeq_epi8(source, _mm_set1_epi8(static_cast<char>(i)));
+      shade = _mm_or_si128(shade, _mm_and_si128(match, _mm_set1_epi8(static_cast<char>(shades[i]))));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), shade);
+  }
+#endif
+  for (; x < count; ++x) {
+    bool showObj = (obj[x] & ObjColour) && !((obj[x] & ObjBehind) && bg[x] != 0);
+    out[x] = shades[showObj ? (obj[x] & (ObjColour | ObjPalette)) | 0x08u : bg[x]];
+  }
+}
+
+//! 0xFF in each byte of \p v that is non-zero, 0x00 elsewhere.
+inline uint64_t nonZeroBytes(uint64_t v) {
+  constexpr uint64_t low7 = 0x7F7F7F7F7F7F7F7Full;
+  uint64_t high = (((v & low7) + low7) | v) & ~low7;
+  return (high >> 7u) * 0xFFu;
+}
+
+} // End anonymous namespace.
+
+const uint8_t *Renderer::renderLine(const LineRegs &regs, const uint8_t *vram,
+                                    const uint8_t *oam, const uint8_t *sprites,
+                                    unsigned spriteCount, uint8_t *out, PixelFormat format) {
+  renderBackground(regs, vram);
+  renderSprites(regs, vram, oam, sprites, spriteCount);
+
+  // Shades go straight to the output when that's the format wanted, and are
+  // converted from one line of L1 otherwise.
+  uint8_t *shades = format == PixelFormat::Index8 && out != nullptr ? out : shadeLine;
+
+  // The shade of each source index mix() picks.
+  uint8_t sourceShades[16] = {};
+  for (unsigned i = 0; i < 4; ++i) {
+    sourceShades[i] = (regs.bgp >> (i * 2u)) & 3u;
+    sourceShades[8 + i] = (regs.obp0 >> (i * 2u)) & 3u;
+    sourceShades[12 + i] = (regs.obp1 >> (i * 2u)) & 3u;
+  }
+  mix(bgLine, objLine + objMargin, sourceShades, lcd::width, shades);
+
+  uint64_t lineHash = hashutil::hash64(shades, lcd::width, regs.ly);
+  frameHashSoFar = regs.ly == 0 ? lineHash : hashutil::round(frameHashSoFar, lineHash);
+  if (regs.ly == lcd::height - 1)
+    lastFrameHash.store(hashutil::mix(frameHashSoFar), std::memory_order_release);
+
+  if (shades != out && out != nullptr)
+    pixelfmt::convert(format, shades, lcd::width, out);
+  return shades;
+}
+
+void Renderer::renderBackground(const LineRegs &regs, const uint8_t *vram) {
+  // With BG disabled both BG and window are colour 0.
+  if (!(regs.lcdc & lcd::BgEnable)) {
+    std::memset(bgLine, 0, sizeof bgLine);
+    return;
+  }
+
+  bool unsignedTiles = regs.lcdc & lcd::TileData;
+
+  // Background, scrolled by SCX/SCY and wrapping around the 256x256 map.
+  unsigned y = (regs.scy + regs.ly) & 0xFFu;
+  const uint8_t *row = maps.row((regs.lcdc & lcd::BgMap) ? 1u : 0u, unsignedTiles, y, vram, tiles);
+  unsigned right = std::min(BgMapCache::mapSize - regs.scx, lcd::width);
+  std::memcpy(bgLine, row + regs.scx, right);
+  std::memcpy(bgLine + right, row, lcd::width - right);
+
+  // Window, from WX-7 to the right edge.
+  if (!windowVisible(regs))
+    return;
+
+  int left = regs.wx - 7;
+  unsigned start = left < 0 ? 0 : static_cast<unsigned>(left);
+  row = maps.row((regs.lcdc & lcd::WindowMap) ? 1u : 0u, unsignedTiles, regs.windowLine, vram,
+                 tiles);
+  std::memcpy(bgLine + start, row + (start - left), lcd::width - start);
+}
+
+void Renderer::renderSprites(const LineRegs &regs, const uint8_t *vram, const uint8_t *oam,
+                             const uint8_t *sprites, unsigned spriteCount) {
+  std::memset(objLine, 0, sizeof objLine);
+  if (!(regs.lcdc & lcd::ObjEnable) || spriteCount == 0)
+    return;
+
+  // Lower X wins, then lower OAM index. Sprites arrive in OAM order, so a
+  // stable sort gives priority order.
+  uint8_t order[lcd::maxLineSprites];
+  std::copy(sprites, sprites + spriteCount, order);
+  std::stable_sort(order, order + spriteCount,
+                   [oam](uint8_t a, uint8_t b) { return oam[a * 4 + 1] < oam[b * 4 + 1]; });
+
+  unsigned height = (regs.lcdc & lcd::ObjSize) ? 16 : 8;
+  for (unsigned i = 0; i < spriteCount; ++i) {
+    const uint8_t *obj = oam + order[i] * 4;
+    uint8_t flags = obj[3];
+
+    // OAM or the sprite size may have changed since the line's sprites were
+    // selected, leaving the sprite off the line.
+    unsigned row = regs.ly + 16u - obj[0];
+    if (row >= height)
+      continue;
+    if (flags & lcd::YFlip)
+      row = height - 1 - row;
+    // The lower row of an 8x16 sprite is the next tile.
+    unsigned tile = (height == 16 ? (obj[2] & 0xFEu) : obj[2]) + row / 8u;
+
+    // The leftmost pixel is the lowest byte.
+    uint64_t pixels;
+    std::memcpy(&pixels, tiles.row(tile, row & 7u, vram), sizeof pixels);
+    if (flags & lcd::XFlip)
+      pixels = __builtin_bswap64(pixels);
+
+    uint64_t attrs = ((flags & lcd::Palette) ? static_cast<uint64_t>(ObjPalette) : 0u) |
+                     ((flags & lcd::BgPriority) ? static_cast<uint64_t>(ObjBehind) : 0u);
+    pixels |= nonZeroBytes(pixels) & (attrs * 0x0101010101010101ull);
+
+    // Higher priority sprites were drawn first; only fill gaps they left.
+    // X is 0-255 so the margins take any part off screen.
+    uint8_t *dst = objLine + obj[1];
+    uint64_t drawn;
+    std::memcpy(&drawn, dst, sizeof drawn);
+    drawn |= pixels & ~nonZeroBytes(drawn);
+    std::memcpy(dst, &drawn, sizeof drawn);
+  }
+}
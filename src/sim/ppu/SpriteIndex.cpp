@@ -0,0 +1,36 @@
+#include "sim/ppu/SpriteIndex.h"
+
+#include <algorithm>
+
+SpriteIndex::SpriteIndex() : lines(), ys() { }
+
+void SpriteIndex::rebuild(const uint8_t *oam) {
+  std::fill(&lines[0][0], &lines[0][0] + 2 * lcd::height, 0);
+  for (unsigned i = 0; i < spriteCount; ++i) {
+    ys[i] = oam[i * 4u];
+    mark(i, ys[i], true);
+  }
+}
+
+void SpriteIndex::move(unsigned sprite, uint8_t y) {
+  mark(sprite, ys[sprite], false);
+  ys[sprite] = y;
+  mark(sprite, y, true);
+}
+
+void SpriteIndex::mark(unsigned sprite, uint8_t y, bool on) {
+  // Sprite Y is the bottom of a 16 line sprite, offset by 16, so a sprite
+  // covers lines y - 16 up to y - 8 or y.
+  int top = y - 16;
+  uint64_t bit = 1ull << sprite;
+  for (unsigned tall = 0; tall < 2; ++tall) {
+    int first = std::max(top, 0);
+    int end = std::min(top + (tall ? 16 : 8), static_cast<int>(lcd::height));
+    for (int ly = first; ly < end; ++ly) {
+      if (on)
+        lines[tall][ly] |= bit;
+      else
+        lines[tall][ly] &= ~bit;
+    }
+  }
+}
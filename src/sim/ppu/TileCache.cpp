@@ -0,0 +1,8 @@
+#include "sim/ppu/TileCache.h"
+
+#include "sim/ppu/TileDecoder.h"
+
+void TileCache::decode(unsigned index, const uint8_t *vram) {
+  // A tile's 16 bytes are 8 consecutive rows of plane pairs.
+  TileDecoder::decode(vram + index * 16u, 8, tiles[index]);
+}
@@ -0,0 +1,107 @@
+#include "sim/rom/CartridgeHeader.h"
+
+#include <cstring>
+
+namespace {
+
+//! The Nintendo logo bitmap expected at 0x0104-0x0133.
+constexpr uint8_t logo[48] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83,
+    0x00, 0x0C, 0x00, 0x0D, 0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E,
+    0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99, 0xBB, 0xBB, 0x67, 0x63,
+    0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E};
+
+//! The mapper family for a cartridge type byte.
+Mapper mapperFor(uint8_t type) {
+  switch (type) {
+  case 0x00: case 0x08: case 0x09:
+    return Mapper::None;
+  case 0x01: case 0x02: case 0x03:
+    return Mapper::MBC1;
+  case 0x05: case 0x06:
+    return Mapper::MBC2;
+  case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13:
+    return Mapper::MBC3;
+  case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E:
+    return Mapper::MBC5;
+  default:
+    return Mapper::Other;
+  }
+}
+
+//! Whether a cartridge type byte has a battery.
+bool hasBattery(uint8_t type) {
+  switch (type) {
+  case 0x03: case 0x06: case 0x09: case 0x0D: case 0x0F: case 0x10:
+  case 0x13: case 0x1B: case 0x1E: case 0x22: case 0xFF:
+    return true;
+  default:
+    return false;
+  }
+}
+
+//! The external RAM size in bytes for a RAM size code.
+uint32_t ramSizeFor(uint8_t code) {
+  switch (code) {
+  case 0x01: return 1u << 11u;
+  case 0x02: return 1u << 13u;
+  case 0x03: return 1u << 15u;
+  case 0x04: return 1u << 17u;
+  case 0x05: return 1u << 16u;
+  default: return 0;
+  }
+}
+
+} // End anonymous namespace.
+
+bool CartridgeHeader::parse(const uint8_t *rom, std::size_t size, CartridgeHeader &header) {
+  std::memset(&header, 0, sizeof header);
+  if (size < end)
+    return false;
+
+  // A CGB flag in 0x0143 shortens the title to 15 characters.
+  bool cgb = (rom[0x143] & 0x80u) != 0;
+  std::memcpy(header.title, rom + 0x134, cgb ? 15 : 16);
+
+  header.type = rom[0x147];
+  header.romSizeCode = rom[0x148];
+  header.ramSizeCode = rom[0x149];
+  header.version = rom[0x14C];
+  header.headerChecksum = rom[0x14D];
+  header.globalChecksum = static_cast<uint16_t>((rom[0x14E] << 8u) | rom[0x14F]);
+  header.mapper = mapperFor(header.type);
+
+  header.romSize = header.romSizeCode <= 0x08 ? (1u << 15u) << header.romSizeCode : 0;
+  // MBC2 has 512 half-bytes built in and reports no RAM in the header.
+  header.ramSize = header.mapper == Mapper::MBC2 ? 512 : ramSizeFor(header.ramSizeCode);
+
+  uint8_t flags = 0;
+  if (cgb)
+    flags |= CGB;
+  if (hasBattery(header.type))
+    flags |= Battery;
+  if (header.type == 0x0F || header.type == 0x10)
+    flags |= Timer;
+  if (std::memcmp(rom + 0x104, logo, sizeof logo) == 0)
+    flags |= LogoOk;
+  if (header.romSize != 0 && header.romSize == size)
+    flags |= SizeOk;
+
+  // The header checksum covers 0x0134-0x014C.
+  uint8_t check = 0;
+  for (std::size_t i = 0x134; i <= 0x14C; ++i)
+    check = static_cast<uint8_t>(check - rom[i] - 1);
+  if (check == header.headerChecksum)
+    flags |= HeaderChecksumOk;
+
+  // The global checksum covers every byte but itself.
+  uint16_t global = 0;
+  for (std::size_t i = 0; i < size; ++i)
+    global = static_cast<uint16_t>(global + rom[i]);
+  global = static_cast<uint16_t>(global - rom[0x14E] - rom[0x14F]);
+  if (global == header.globalChecksum)
+    flags |= GlobalChecksumOk;
+
+  header.flags = flags;
+  return true;
+}
@@ -0,0 +1,36 @@
+#include "sim/rom/RomImage.h"
+
+#include "loguru.hpp"
+
+#include <fstream>
+
+std::shared_ptr<const RomImage> RomImage::load(const char *romLoc) {
+  DLOG_S(INFO) << "Opening ROM at " << romLoc;
+  std::ifstream rom(romLoc, std::ifstream::in | std::ifstream::binary);
+  if (!rom.is_open()) {
+    LOG_F(ERROR, "ROM failed to open.");
+    return nullptr;
+  }
+
+  rom.seekg(0, std::ifstream::end);
+  std::streamoff trueSize = rom.tellg();
+  rom.seekg(0, std::ifstream::beg);
+  DLOG_S(1) << "ROM true size: " << trueSize;
+
+  auto image = std::make_shared<RomImage>();
+  image->romPath = romLoc;
+  image->fileSize = static_cast<std::size_t>(trueSize);
+
+  // Pad to whole banks so bank lookups never need a bounds check.
+  std::size_t banks = (image->fileSize + bankSize - 1) / bankSize;
+  image->bytes.assign((banks < 2 ? 2 : banks) * bankSize, 0xFF);
+  rom.read(reinterpret_cast<char *>(image->bytes.data()), trueSize);
+  DLOG_IF_F(1, rom.bad(), "ROM read failure!");
+
+  if (!CartridgeHeader::parse(image->bytes.data(), image->fileSize, image->cartHeader)) {
+    LOG_F(ERROR, "ROM too small to hold a cartridge header.");
+    return nullptr;
+  }
+
+  return image;
+}
@@ -0,0 +1,276 @@
+#include "sim/rom/RomIndex.h"
+
+#include "sim/util/Hash.h"
+
+#include "loguru.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+static_assert(std::is_trivially_copyable<RomIndex::Entry>::value,
+              "Index entries are written to disk as-is.");
+
+//! The index file header.
+struct FileHeader {
+  //! Always "GBRI".
+  char magic[4];
+
+  //! The format version, bumped whenever ::RomIndex::Entry changes.
+  uint32_t version;
+
+  //! The number of entries following the header.
+  uint64_t count;
+
+  //! The size of the string table following the entries.
+  uint64_t stringsSize;
+};
+
+constexpr char indexMagic[4] = {'G', 'B', 'R', 'I'};
+constexpr uint32_t indexVersion = 1;
+
+//! Whether a path looks like a ROM.
+bool isRom(const std::filesystem::path &path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == ".gb" || ext == ".gbc";
+}
+
+/**
+ * \brief Map, parse and hash one ROM.
+ * \return Whether the ROM was indexed.
+ */
+bool indexRom(const std::string &path, RomIndex::Entry &entry) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG_F(WARNING, "Failed to open ROM %s: skipped.", path.c_str());
+    return false;
+  }
+
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < CartridgeHeader::end) {
+    LOG_F(WARNING, "ROM %s too small for a header: skipped.", path.c_str());
+    ::close(fd);
+    return false;
+  }
+
+  auto size = static_cast<std::size_t>(st.st_size);
+  void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    LOG_F(WARNING, "Failed to map ROM %s: skipped.", path.c_str());
+    return false;
+  }
+  ::madvise(data, size, MADV_SEQUENTIAL);
+
+  const auto *rom = static_cast<const uint8_t *>(data);
+  CartridgeHeader::parse(rom, size, entry.header);
+  entry.contentHash = hashutil::hash64(rom, size);
+  entry.pathHash = hashutil::hash64(path.data(), path.size());
+  entry.mtime = st.st_mtime;
+  entry.fileSize = static_cast<uint32_t>(size);
+  DLOG_IF_F(1, !entry.header.valid(), "ROM %s failed header validation (flags 0x%02X).",
+            path.c_str(), entry.header.flags);
+
+  ::munmap(data, size);
+  return true;
+}
+
+} // End anonymous namespace.
+
+RomIndex::RomIndex()
+    : entries(nullptr), count(0), strings(""), map(nullptr), mapSize(0) { }
+
+RomIndex::RomIndex(RomIndex &&other) noexcept
+    : entries(other.entries), count(other.count), strings(other.strings),
+      map(other.map), mapSize(other.mapSize),
+      ownedEntries(std::move(other.ownedEntries)),
+      ownedStrings(std::move(other.ownedStrings)) {
+  // Owned storage may have moved (short strings live inline).
+  if (map == nullptr) {
+    entries = ownedEntries.data();
+    strings = ownedStrings.c_str();
+  }
+  other.map = nullptr;
+  other.clear();
+}
+
+RomIndex::~RomIndex() {
+  clear();
+}
+
+void RomIndex::clear() {
+  if (map != nullptr)
+    ::munmap(map, mapSize);
+  map = nullptr;
+  mapSize = 0;
+  ownedEntries.clear();
+  ownedStrings.clear();
+  entries = nullptr;
+  count = 0;
+  strings = "";
+}
+
+RomIndex RomIndex::build(const std::vector<std::string> &paths, unsigned threads) {
+  // Expand directories into ROM files.
+  std::vector<std::string> files;
+  for (const std::string &path : paths) {
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec)) {
+      for (const auto &item : std::filesystem::recursive_directory_iterator(path, ec))
+        if (item.is_regular_file(ec) && isRom(item.path()))
+          files.push_back(item.path().string());
+    }
+    else {
+      files.push_back(path);
+    }
+  }
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(files.size(), 1)));
+  LOG_F(INFO, "Indexing %zu ROMs on %u threads.", files.size(), threads);
+
+  // Workers pull files off a shared counter so slow (large) ROMs don't
+  // serialise a static partition.
+  std::vector<Entry> found(files.size());
+  std::vector<uint8_t> ok(files.size(), 0);
+  std::atomic<std::size_t> next(0);
+  auto worker = [&]() {
+    for (std::size_t i = next++; i < files.size(); i = next++)
+      ok[i] = indexRom(files[i], found[i]);
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread &t : pool)
+    t.join();
+
+  // Gather the indexed entries and their paths.
+  RomIndex index;
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    if (!ok[i])
+      continue;
+    Entry entry = found[i];
+    entry.pathOffset = static_cast<uint32_t>(index.ownedStrings.size());
+    entry.pathLength = static_cast<uint32_t>(files[i].size());
+    index.ownedStrings.append(files[i]);
+    index.ownedStrings.push_back('\0');
+    index.ownedEntries.push_back(entry);
+  }
+
+  std::sort(index.ownedEntries.begin(), index.ownedEntries.end(),
+            [](const Entry &a, const Entry &b) { return a.pathHash < b.pathHash; });
+
+  index.entries = index.ownedEntries.data();
+  index.count = index.ownedEntries.size();
+  index.strings = index.ownedStrings.c_str();
+  LOG_F(INFO, "Indexed %zu ROMs.", index.count);
+  return index;
+}
+
+bool RomIndex::save(const char *path) const {
+  std::ofstream out(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+  if (!out.is_open()) {
+    LOG_F(ERROR, "Index %s failed to open.", path);
+    return false;
+  }
+
+  // Include the string table's terminating NUL so an empty table is valid.
+  uint64_t stringsSize = ownedStrings.size() + 1;
+  if (map != nullptr)
+    stringsSize = mapSize - sizeof(FileHeader) - count * sizeof(Entry);
+
+  FileHeader header {};
+  std::memcpy(header.magic, indexMagic, sizeof indexMagic);
+  header.version = indexVersion;
+  header.count = count;
+  header.stringsSize = stringsSize;
+
+  out.write(reinterpret_cast<const char *>(&header), sizeof header);
+  out.write(reinterpret_cast<const char *>(entries), static_cast<std::streamsize>(count * sizeof(Entry)));
+  out.write(strings, static_cast<std::streamsize>(stringsSize));
+  return out.good();
+}
+
+bool RomIndex::open(const char *path) {
+  clear();
+
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG_F(WARNING, "Index %s failed to open.", path);
+    return false;
+  }
+
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(FileHeader)) {
+    LOG_F(WARNING, "Index %s is truncated.", path);
+    ::close(fd);
+    return false;
+  }
+
+  auto size = static_cast<std::size_t>(st.st_size);
+  void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    LOG_F(WARNING, "Index %s failed to map.", path);
+    return false;
+  }
+
+  // The count is checked against the size before it is multiplied, so a
+  // corrupt one can't overflow past the size check.
+  FileHeader header {};
+  std::memcpy(&header, data, sizeof header);
+  std::size_t body = size - sizeof header;
+  bool valid = std::memcmp(header.magic, indexMagic, sizeof indexMagic) == 0 &&
+               header.version == indexVersion && header.count <= body / sizeof(Entry) &&
+               header.stringsSize != 0 &&
+               header.count * sizeof(Entry) + header.stringsSize == body;
+
+  // Every path must lie within the string table and end in a NUL.
+  const auto *base = static_cast<const char *>(data);
+  const auto *mapped = reinterpret_cast<const Entry *>(base + sizeof header);
+  const char *table = base + sizeof header + (valid ? header.count * sizeof(Entry) : 0);
+  for (std::size_t i = 0; valid && i < header.count; ++i) {
+    uint64_t end = static_cast<uint64_t>(mapped[i].pathOffset) + mapped[i].pathLength;
+    valid = end < header.stringsSize && table[end] == '\0';
+  }
+
+  if (!valid) {
+    LOG_F(WARNING, "Index %s is invalid or from another version.", path);
+    ::munmap(data, size);
+    return false;
+  }
+
+  map = data;
+  mapSize = size;
+  count = header.count;
+  entries = mapped;
+  strings = table;
+  DLOG_F(1, "Opened index %s with %zu entries.", path, count);
+  return true;
+}
+
+const RomIndex::Entry *RomIndex::find(const std::string &path) const {
+  uint64_t hash = hashutil::hash64(path.data(), path.size());
+  const Entry *it = std::lower_bound(begin(), end(), hash,
+                                     [](const Entry &e, uint64_t h) { return e.pathHash < h; });
+  for (; it != end() && it->pathHash == hash; ++it)
+    if (path.compare(0, std::string::npos, strings + it->pathOffset, it->pathLength) == 0)
+      return it;
+  return nullptr;
+}
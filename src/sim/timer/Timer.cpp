@@ -0,0 +1,115 @@
+#include "sim/timer/Timer.h"
+
+#include "sim/MachineState.h"
+
+#include "loguru.hpp"
+
+Timer::Timer(MachineState &state, Scheduler &scheduler) : state(state), scheduler(scheduler) { }
+
+void Timer::reset() {
+  DLOG_F(1, "Resetting timer.");
+  TimerState &t = state.timer;
+  t = TimerState();
+  t.divBase = state.cycles - bootDivider;
+  t.synced = state.cycles;
+  state.IO[tmr::TIMA] = 0;
+  state.IO[tmr::TMA] = 0;
+  state.IO[tmr::TAC] = 0xF8u;
+  schedule();
+}
+
+void Timer::sync() {
+  TimerState &t = state.timer;
+  uint8_t tac = state.IO[tmr::TAC];
+  if (tac & tmr::Enable) {
+    // Falling edges of the selected bit are where the divider passes a
+    // multiple of the period.
+    unsigned shift = periodShift(tac);
+    count(((state.cycles - t.divBase) >> shift) - ((t.synced - t.divBase) >> shift));
+  }
+  t.synced = state.cycles;
+  schedule();
+}
+
+void Timer::schedule() {
+  const TimerState &t = state.timer;
+  const uint8_t *io = state.IO.data();
+  if (!(io[tmr::TAC] & tmr::Enable)) {
+    scheduler.cancel(Scheduler::Timer);
+    return;
+  }
+
+  // The first edge after the catch up, then one per increment until TIMA
+  // wraps.
+  unsigned shift = periodShift(io[tmr::TAC]);
+  uint64_t since = t.synced - t.divBase;
+  uint64_t edge = t.synced + ((((since >> shift) + 1) << shift) - since);
+  scheduler.schedule(Scheduler::Timer, edge + (static_cast<uint64_t>(0xFFu - io[tmr::TIMA]) << shift));
+}
+
+uint8_t Timer::read(uint8_t reg) {
+  switch (reg) {
+  case tmr::DIV:
+    return static_cast<uint8_t>((state.cycles - state.timer.divBase) >> 8u);
+  case tmr::TIMA:
+    sync();
+    return state.IO[reg];
+  case tmr::TAC:
+    return state.IO[reg] | 0xF8u;
+  default:
+    return state.IO[reg];
+  }
+}
+
+void Timer::write(uint8_t reg, uint8_t value) {
+  sync();
+  uint8_t *io = state.IO.data();
+  bool line = clockLine(io[tmr::TAC], divider());
+
+  switch (reg) {
+  // Any write resets the divider.
+  case tmr::DIV:
+    state.timer.divBase = state.timer.synced;
+    break;
+  case tmr::TAC:
+    io[reg] = static_cast<uint8_t>(value | 0xF8u);
+    break;
+  default:
+    io[reg] = value;
+    break;
+  }
+
+  // TIMA is clocked by the falling edge, whatever made it fall.
+  if (line && !clockLine(io[tmr::TAC], divider()))
+    count(1);
+  schedule();
+}
+
+uint16_t Timer::divider() const {
+  return static_cast<uint16_t>(state.timer.synced - state.timer.divBase);
+}
+
+unsigned Timer::periodShift(uint8_t tac) {
+  constexpr unsigned shifts[4] = {10, 4, 6, 8};
+  return shifts[tac & tmr::Clock];
+}
+
+bool Timer::clockLine(uint8_t tac, uint16_t div) {
+  return (tac & tmr::Enable) && (div >> (periodShift(tac) - 1u) & 1u);
+}
+
+void Timer::count(uint64_t edges) {
+  uint8_t *io = state.IO.data();
+  unsigned tima = io[tmr::TIMA];
+  if (edges < 0x100u - tima) {
+    io[tmr::TIMA] = static_cast<uint8_t>(tima + edges);
+    return;
+  }
+
+  // Each overflow reloads TMA, so after the first TIMA wraps every
+  // 0x100 - TMA increments.
+  edges -= 0x100u - tima;
+  unsigned period = 0x100u - io[tmr::TMA];
+  io[tmr::TIMA] = static_cast<uint8_t>(io[tmr::TMA] + edges % period);
+  io[irq::IF] |= irq::Timer;
+}